@@ -57,6 +57,13 @@ class isolate_t {
         std::unique_ptr<handle_t>
         spawn(const std::string& path, const string_map_t& args, const string_map_t& environment, int pipe) = 0;
 
+        // Isolate resource usage statistics, reported as a part of the app info.
+        virtual
+        Json::Value
+        info() const {
+            return Json::Value(Json::objectValue);
+        }
+
     protected:
         isolate_t(context_t&, const std::string& /* name */, const Json::Value& /* args */) {
             // Empty.
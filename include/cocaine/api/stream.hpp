@@ -23,6 +23,8 @@
 
 #include "cocaine/common.hpp"
 
+#include <functional>
+
 namespace cocaine { namespace api {
 
 struct stream_t {
@@ -42,6 +44,18 @@ struct stream_t {
     virtual
     void
     close() = 0;
+
+    // Flow control. The handler is invoked with true when the stream can't keep up with the
+    // writes, and with false when it has caught up. A null handler cancels the notifications.
+    // Streams without flow control never invoke it.
+
+    typedef std::function<void(bool)> pressure_handler_t;
+
+    virtual
+    void
+    watch(const pressure_handler_t& /* handler */) {
+        // Empty.
+    }
 };
 
 typedef std::shared_ptr<stream_t> stream_ptr_t;
@@ -25,10 +25,13 @@
 
 #include "json/json.h"
 
+#include <mutex>
 #include <thread>
 
 namespace cocaine {
 
+class actor_t;
+
 class app_t {
     COCAINE_DECLARE_NONCOPYABLE(app_t)
 
@@ -53,6 +56,9 @@ class app_t {
         std::shared_ptr<api::stream_t>
         enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream, const std::string& tag);
 
+        std::vector<std::shared_ptr<api::stream_t>>
+        enqueue(const std::vector<std::pair<api::event_t, std::shared_ptr<api::stream_t>>>& batch);
+
     private:
         void
         deploy(const std::string& name, const std::string& path);
@@ -85,9 +91,14 @@ class app_t {
 
         driver_map_t m_drivers;
 
-        // App service
+        // App service, which is owned by the context while the app is running.
 
         struct service_t;
+
+        actor_t* m_service;
+
+        // Guards the app service pointer, which is reported on from other threads.
+        mutable std::mutex m_service_mutex;
 };
 
 } // namespace cocaine
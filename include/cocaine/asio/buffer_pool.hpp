@@ -0,0 +1,170 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_BUFFER_POOL_HPP
+#define COCAINE_IO_BUFFER_POOL_HPP
+
+#include "cocaine/common.hpp"
+
+#include <mutex>
+
+namespace cocaine { namespace io {
+
+// Process-wide pool of I/O buffers, shared by all the streams in all the reactors. Buffers are
+// allocated in power-of-two size classes, so that they could be reused by any stream, and the total
+// amount of memory retained in the pool is capped.
+
+struct buffer_pool_t {
+    COCAINE_DECLARE_NONCOPYABLE(buffer_pool_t)
+
+    typedef std::vector<char> buffer_type;
+
+    struct policy_t {
+        // Initial size of a stream buffer.
+        size_t initial_size;
+
+        // Maximum size of a stream buffer.
+        size_t size_limit;
+
+        // Maximum amount of memory retained in the pool.
+        size_t pool_limit;
+
+        // Idle stream buffers are returned to the pool after this timeout, zero disables it.
+        float idle_timeout;
+
+        // Writable streams report congestion once the amount of pending data exceeds the high
+        // watermark, and recovery once it drops below the low watermark. Zero disables it.
+        size_t low_watermark;
+        size_t high_watermark;
+    };
+
+    buffer_pool_t():
+        m_retained(0)
+    {
+        m_policy.initial_size = 4096;
+        m_policy.size_limit   = 67108864;
+        m_policy.pool_limit   = 67108864;
+        m_policy.idle_timeout = 30.0f;
+        m_policy.low_watermark  = 4194304;
+        m_policy.high_watermark = 16777216;
+    }
+
+    void
+    configure(const policy_t& policy) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_policy = policy;
+
+        while(m_retained > m_policy.pool_limit && !m_slabs.empty()) {
+            // Trim the largest buffers first.
+            auto it = --m_slabs.end();
+
+            m_retained -= it->first;
+            it->second.pop_back();
+
+            if(it->second.empty()) {
+                m_slabs.erase(it);
+            }
+        }
+    }
+
+    policy_t
+    policy() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_policy;
+    }
+
+    buffer_type
+    acquire(size_t size) {
+        size_t capacity = 1024;
+
+        while(capacity < size) {
+            capacity *= 2;
+        }
+
+        buffer_type buffer;
+
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            auto it = m_slabs.find(capacity);
+
+            if(it != m_slabs.end()) {
+                buffer = std::move(it->second.back());
+                it->second.pop_back();
+
+                if(it->second.empty()) {
+                    m_slabs.erase(it);
+                }
+
+                m_retained -= capacity;
+            }
+        }
+
+        buffer.resize(capacity);
+
+        return buffer;
+    }
+
+    void
+    release(buffer_type buffer) {
+        const size_t capacity = buffer.size();
+
+        if(capacity == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(m_retained + capacity > m_policy.pool_limit || (capacity & (capacity - 1)) != 0) {
+            // The buffer is either not from the pool, or the pool is full, so just drop it.
+            return;
+        }
+
+        m_slabs[capacity].push_back(std::move(buffer));
+        m_retained += capacity;
+    }
+
+    size_t
+    retained() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_retained;
+    }
+
+private:
+    policy_t m_policy;
+
+    // Free buffers, by size class.
+    std::map<size_t, std::vector<buffer_type>> m_slabs;
+    size_t m_retained;
+
+    mutable std::mutex m_mutex;
+};
+
+inline
+buffer_pool_t&
+buffer_pool() {
+    static buffer_pool_t pool_instance;
+    return pool_instance;
+}
+
+}} // namespace cocaine::io
+
+#endif
@@ -23,9 +23,11 @@
 
 #include "cocaine/common.hpp"
 
+#include "cocaine/detail/atomic.hpp"
+
+#include <algorithm>
 #include <deque>
 #include <functional>
-#include <mutex>
 
 #if defined(__clang__)
     #pragma clang diagnostic push
@@ -51,11 +53,16 @@ struct reactor_t {
 
     typedef ev::dynamic_loop native_type;
     typedef std::function<void()> job_type;
+    typedef std::function<bool()> task_type;
 
     reactor_t():
         m_loop(new ev::dynamic_loop()),
         m_loop_queue_pump(new ev::prepare(*m_loop)),
-        m_loop_async_wake(new ev::async(*m_loop))
+        m_loop_async_wake(new ev::async(*m_loop)),
+        m_loop_task_pump(new ev::check(*m_loop)),
+        m_loop_task_idle(new ev::idle(*m_loop)),
+        m_job_queue(nullptr),
+        m_job_batch(nullptr)
     {
         // Pumps queued jobs on beginning of each loop iteration.
         m_loop_queue_pump->set<reactor_t, &reactor_t::process>(this);
@@ -64,11 +71,24 @@ struct reactor_t {
         // Wakeups the loop when new jobs are queued.
         m_loop_async_wake->set<reactor_t, &reactor_t::wakeup>(this);
         m_loop_async_wake->start();
+
+        // Steps scheduled tasks at the end of each loop iteration.
+        m_loop_task_pump->set<reactor_t, &reactor_t::step>(this);
+        m_loop_task_pump->start();
+
+        // Keeps the loop from blocking while there are scheduled tasks.
+        m_loop_task_idle->set<reactor_t, &reactor_t::spin>(this);
     }
 
    ~reactor_t() {
+        m_loop_task_idle->stop();
+        m_loop_task_pump->stop();
         m_loop_async_wake->stop();
         m_loop_queue_pump->stop();
+
+        // Drop all the jobs which were never processed.
+        destroy(m_job_batch);
+        destroy(m_job_queue.exchange(nullptr));
     }
 
     void
@@ -97,20 +117,52 @@ struct reactor_t {
     }
 
     void
-    post(const job_type& job) {
-        std::unique_lock<std::mutex> lock(m_job_queue_mutex);
-
-        m_job_queue.push_back(job);
-
-        if(m_job_queue.size() == 1) {
-            lock.unlock();
+    post(job_type job) {
+        job_node_t* node = new job_node_t { std::move(job), m_job_queue.load(std::memory_order_relaxed) };
+
+        while(!m_job_queue.compare_exchange_weak(
+            node->next,
+            node,
+            std::memory_order_release,
+            std::memory_order_relaxed))
+        {
+            // Retry, node->next has been updated with the current queue head.
+        }
 
+        if(node->next == nullptr) {
             // Wake up the event loop, in case it's the only job in the queue,
-            // otherwise it's probably already awake.
+            // otherwise it's already awake and will pick this job up anyway.
             m_loop_async_wake->send();
         }
     }
 
+    // Fair scheduling. Tasks are stepped in a round-robin fashion, one step per task per loop
+    // iteration, until they report that there's nothing left to do. Each task is identified by
+    // its owner, so that it could be cancelled when the owner goes away. Loop thread only.
+
+    void
+    schedule(const void* owner, task_type task) {
+        if(m_tasks.insert(std::make_pair(owner, std::move(task))).second) {
+            m_task_order.push_back(owner);
+        }
+
+        if(!m_loop_task_idle->is_active()) {
+            m_loop_task_idle->start();
+        }
+    }
+
+    void
+    cancel(const void* owner) {
+        if(m_tasks.erase(owner)) {
+            m_task_order.erase(std::remove(m_task_order.begin(), m_task_order.end(), owner), m_task_order.end());
+        }
+    }
+
+    bool
+    scheduled(const void* owner) const {
+        return m_tasks.find(owner) != m_tasks.end();
+    }
+
     void
     update() {
         ev_now_update(*m_loop);
@@ -125,21 +177,35 @@ public:
 private:
     void
     process(ev::prepare&, int) {
-        job_type job;
+        // Finish the batch which was interrupted by an exception, if any.
+        drain();
 
-        while(!m_job_queue.empty()) {
-            std::unique_lock<std::mutex> lock(m_job_queue_mutex);
+        // Take the whole queue with a single swap. The queue is a stack, so it has to be reversed
+        // to preserve the posting order. Jobs posted from now on will wake up the loop again.
+        job_node_t* head = m_job_queue.exchange(nullptr, std::memory_order_acquire);
 
-            if(m_job_queue.empty()) {
-                return;
-            }
+        while(head) {
+            job_node_t* next = head->next;
+
+            head->next = m_job_batch;
+            m_job_batch = head;
+
+            head = next;
+        }
+
+        drain();
+    }
 
-            job = m_job_queue.front();
-            m_job_queue.pop_front();
+    void
+    drain() {
+        while(m_job_batch) {
+            std::unique_ptr<job_node_t> node(m_job_batch);
 
-            lock.unlock();
+            // NOTE: Advance before invoking the job, so that if it throws, the rest of the batch
+            // will be picked up on the next loop iteration.
+            m_job_batch = node->next;
 
-            job();
+            node->job();
         }
     }
 
@@ -148,6 +214,39 @@ private:
         // Pass.
     }
 
+    void
+    step(ev::check&, int) {
+        // NOTE: Only the tasks which were scheduled before this round are stepped, so that a task
+        // rescheduling itself gets its next step on the next loop iteration.
+        size_t round = m_task_order.size();
+
+        while(round-- && !m_task_order.empty()) {
+            const void* owner = m_task_order.front();
+
+            m_task_order.pop_front();
+
+            // NOTE: The task is copied, as it might cancel itself while being stepped.
+            const task_type task = m_tasks[owner];
+
+            if(task()) {
+                if(scheduled(owner)) {
+                    m_task_order.push_back(owner);
+                }
+            } else {
+                cancel(owner);
+            }
+        }
+
+        if(m_task_order.empty() && m_loop_task_idle->is_active()) {
+            m_loop_task_idle->stop();
+        }
+    }
+
+    void
+    spin(ev::idle&, int) {
+        // Pass.
+    }
+
 private:
     struct throw_action {
         void
@@ -161,12 +260,35 @@ private:
         reactor_t& self;
     };
 
+    struct job_node_t {
+        job_type job;
+        job_node_t* next;
+    };
+
+    static
+    void
+    destroy(job_node_t* head) {
+        while(head) {
+            std::unique_ptr<job_node_t> node(head);
+            head = node->next;
+        }
+    }
+
     std::unique_ptr<native_type> m_loop;
     std::unique_ptr<ev::prepare> m_loop_queue_pump;
     std::unique_ptr<ev::async>   m_loop_async_wake;
+    std::unique_ptr<ev::check>   m_loop_task_pump;
+    std::unique_ptr<ev::idle>    m_loop_task_idle;
+
+    // Intrusive lock-free job stack, pushed by any thread and swapped out by the loop thread.
+    std::atomic<job_node_t*> m_job_queue;
+
+    // Jobs taken from the stack, in the posting order. Touched only by the loop thread.
+    job_node_t* m_job_batch;
 
-    std::deque<job_type> m_job_queue;
-    std::mutex m_job_queue_mutex;
+    // Scheduled tasks, by owner, and their round-robin order. Touched only by the loop thread.
+    std::map<const void*, task_type> m_tasks;
+    std::deque<const void*> m_task_order;
 };
 
 }} // namespace cocaine::io
@@ -21,6 +21,7 @@
 #ifndef COCAINE_IO_BUFFERED_READABLE_STREAM_HPP
 #define COCAINE_IO_BUFFERED_READABLE_STREAM_HPP
 
+#include "cocaine/asio/buffer_pool.hpp"
 #include "cocaine/asio/reactor.hpp"
 
 #include <cstring>
@@ -37,27 +38,39 @@ struct readable_stream {
     readable_stream(reactor_t& reactor, endpoint_type endpoint):
         m_socket(std::make_shared<socket_type>(endpoint)),
         m_socket_watcher(reactor.native()),
-        m_idle_watcher(reactor.native()),
+        m_shrink_timer(reactor.native()),
         m_reactor(reactor),
+        m_policy(buffer_pool().policy()),
         m_rd_offset(0),
-        m_rx_offset(0)
+        m_rx_offset(0),
+        m_throttled(false),
+        m_paused(false)
     {
         m_socket_watcher.set<readable_stream, &readable_stream::on_event>(this);
-        m_idle_watcher.set<readable_stream, &readable_stream::on_idle>(this);
-        m_ring.resize(65536);
+        m_shrink_timer.set<readable_stream, &readable_stream::on_shrink>(this);
+        m_shrink_timer.set(0.0f, m_policy.idle_timeout);
     }
 
     readable_stream(reactor_t& reactor, const std::shared_ptr<socket_type>& socket):
         m_socket(socket),
         m_socket_watcher(reactor.native()),
-        m_idle_watcher(reactor.native()),
+        m_shrink_timer(reactor.native()),
         m_reactor(reactor),
+        m_policy(buffer_pool().policy()),
         m_rd_offset(0),
-        m_rx_offset(0)
+        m_rx_offset(0),
+        m_throttled(false),
+        m_paused(false)
     {
         m_socket_watcher.set<readable_stream, &readable_stream::on_event>(this);
-        m_idle_watcher.set<readable_stream, &readable_stream::on_idle>(this);
-        m_ring.resize(65536);
+        m_shrink_timer.set<readable_stream, &readable_stream::on_shrink>(this);
+        m_shrink_timer.set(0.0f, m_policy.idle_timeout);
+    }
+
+    ~readable_stream() {
+        m_reactor.cancel(this);
+
+        buffer_pool().release(std::move(m_ring));
     }
 
     template<class ReadHandler, class ErrorHandler>
@@ -79,14 +92,48 @@ struct readable_stream {
             m_socket_watcher.stop();
         }
 
-        if(m_idle_watcher.is_active()) {
-            m_idle_watcher.stop();
+        m_reactor.cancel(this);
+
+        if(m_shrink_timer.is_active()) {
+            m_shrink_timer.stop();
         }
 
+        m_throttled = false;
+        m_paused = false;
+
         m_handle_read = nullptr;
         m_handle_error = nullptr;
     }
 
+    // Stops delivering data until resumed, so that the peer is pushed back via the socket buffers.
+
+    void
+    pause() {
+        m_paused = true;
+
+        if(m_socket_watcher.is_active()) {
+            m_socket_watcher.stop();
+        }
+
+        m_reactor.cancel(this);
+    }
+
+    void
+    resume() {
+        if(!m_paused) {
+            return;
+        }
+
+        m_paused = false;
+        m_throttled = false;
+
+        m_socket_watcher.start(m_socket->fd(), ev::READ);
+
+        if(m_rd_offset != m_rx_offset) {
+            schedule();
+        }
+    }
+
     size_t
     footprint() const {
         return m_ring.size();
@@ -95,20 +142,19 @@ struct readable_stream {
 private:
     void
     on_event(ev::io& /* io */, int /* revents */) {
-        while(m_ring.size() - m_rd_offset < 1024) {
-            size_t pending = m_rd_offset - m_rx_offset;
+        if(!prepare()) {
+            m_socket_watcher.stop();
 
-            if(pending > m_ring.size() / 2) {
-                m_ring.resize(m_ring.size() * 2);
-                continue;
+            if(m_reactor.scheduled(this)) {
+                // NOTE: The buffer is full of messages which are not yet processed, so stop reading
+                // until the consumer catches up and let the socket buffers push back on the peer.
+                m_throttled = true;
+            } else {
+                // The buffer is full of a single incomplete message which will never fit.
+                m_reactor.post(std::bind(m_handle_error, std::make_error_code(std::errc::message_size)));
             }
 
-            // There's no space left at the end of the buffer, so copy all the unparsed
-            // data to the beginning and continue filling it from there.
-            std::memmove(m_ring.data(), m_ring.data() + m_rx_offset, pending);
-
-            m_rd_offset = pending;
-            m_rx_offset = 0;
+            return;
         }
 
         // Keep the error code if the read() operation fails.
@@ -139,52 +185,117 @@ private:
 
         m_rd_offset += received;
 
-        try {
-            m_rx_offset += m_handle_read(m_ring.data() + m_rx_offset, m_rd_offset - m_rx_offset);
-        } catch(const std::system_error& e) {
-            m_reactor.post(std::bind(m_handle_error, e.code()));
-            return;
-        }
+        // NOTE: The data is processed in the reactor's round-robin, along with the data pending
+        // in all the other streams, so that a busy peer can't starve the rest of them.
+        schedule();
 
-        if(m_rd_offset != m_rx_offset && !m_idle_watcher.is_active()) {
-            m_idle_watcher.start();
+        if(m_policy.idle_timeout > 0.0f) {
+            m_shrink_timer.again();
         }
     }
 
     void
-    on_idle(ev::idle&, int) {
+    schedule() {
+        if(!m_reactor.scheduled(this)) {
+            m_reactor.schedule(this, std::bind(&readable_stream::on_ready, this));
+        }
+    }
+
+    bool
+    on_ready() {
         size_t parsed = 0;
 
         try {
             parsed = m_handle_read(m_ring.data() + m_rx_offset, m_rd_offset - m_rx_offset);
         } catch(const std::system_error& e) {
             m_reactor.post(std::bind(m_handle_error, e.code()));
+            return false;
+        }
+
+        m_rx_offset += parsed;
+
+        if(m_throttled && !m_paused) {
+            // Resume reading, it will be throttled again if the consumer made no room.
+            m_throttled = false;
+            m_socket_watcher.start(m_socket->fd(), ev::READ);
+        }
+
+        return parsed && m_rd_offset != m_rx_offset;
+    }
+
+    void
+    on_shrink(ev::timer&, int) {
+        m_shrink_timer.stop();
+
+        if(m_rd_offset != m_rx_offset) {
             return;
         }
 
-        if(!parsed || m_rd_offset == m_rx_offset) {
-            m_idle_watcher.stop();
+        // The stream has been idle for a while, so give the buffer back to the pool. A new one
+        // will be acquired on the next read.
+        buffer_pool().release(std::move(m_ring));
+
+        m_ring.clear();
+
+        m_rd_offset = 0;
+        m_rx_offset = 0;
+    }
+
+    bool
+    prepare() {
+        if(m_ring.empty()) {
+            m_ring = buffer_pool().acquire(m_policy.initial_size);
         }
 
-        m_rx_offset += parsed;
+        while(m_ring.size() - m_rd_offset < 1024) {
+            const size_t pending = m_rd_offset - m_rx_offset;
+
+            if(pending > m_ring.size() / 2 && m_ring.size() < m_policy.size_limit) {
+                auto ring = buffer_pool().acquire(std::min(m_ring.size() * 2, m_policy.size_limit));
+
+                std::memcpy(ring.data(), m_ring.data() + m_rx_offset, pending);
+                buffer_pool().release(std::move(m_ring));
+
+                m_ring = std::move(ring);
+            } else if(m_rx_offset != 0) {
+                // There's no space left at the end of the buffer, so copy all the unparsed
+                // data to the beginning and continue filling it from there.
+                std::memmove(m_ring.data(), m_ring.data() + m_rx_offset, pending);
+            } else {
+                return false;
+            }
+
+            m_rd_offset = pending;
+            m_rx_offset = 0;
+        }
+
+        return true;
     }
 
 private:
     const std::shared_ptr<socket_type> m_socket;
 
-    // Socket poll objects.
+    // Socket poll object.
     ev::io m_socket_watcher;
-    ev::idle m_idle_watcher;
+
+    // Returns the buffer to the pool when the stream is idle.
+    ev::timer m_shrink_timer;
 
     // Needed for asynchronous watcher control.
     reactor_t& m_reactor;
 
-    // Ring buffer.
+    const buffer_pool_t::policy_t m_policy;
+
+    // Ring buffer, acquired from the buffer pool.
     std::vector<char> m_ring;
 
     off_t m_rd_offset,
           m_rx_offset;
 
+    // Whether reading is paused until the consumer catches up, or by the user.
+    bool m_throttled,
+         m_paused;
+
     // Socket data callback.
     std::function<
         size_t(const char*, size_t)
@@ -27,6 +27,7 @@
 
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 namespace cocaine { namespace io {
 
@@ -115,6 +116,17 @@ struct socket {
         return length;
     }
 
+    ssize_t
+    write(const iovec* vector, size_t count, std::error_code& ec) {
+        ssize_t length = ::writev(m_fd, vector, count);
+
+        if(length == -1 && (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            ec = std::error_code(errno, std::system_category());
+        }
+
+        return length;
+    }
+
     ssize_t
     read(char* buffer, size_t size, std::error_code& ec) {
         ssize_t length = ::read(m_fd, buffer, size);
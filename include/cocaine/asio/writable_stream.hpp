@@ -21,14 +21,27 @@
 #ifndef COCAINE_IO_BUFFERED_WRITABLE_STREAM_HPP
 #define COCAINE_IO_BUFFERED_WRITABLE_STREAM_HPP
 
+#include "cocaine/asio/buffer_pool.hpp"
 #include "cocaine/asio/reactor.hpp"
 
+#include <climits>
 #include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <sys/uio.h>
 
 namespace cocaine { namespace io {
 
+// NOTE: Streams are written to from any thread, but their socket watchers are only ever touched
+// in the reactor thread, so they must be owned by a std::shared_ptr to schedule that.
+
 template<class Socket>
-struct writable_stream {
+struct writable_stream:
+    public std::enable_shared_from_this<writable_stream<Socket>>
+{
     COCAINE_DECLARE_NONCOPYABLE(writable_stream)
 
     typedef Socket socket_type;
@@ -38,22 +51,28 @@ struct writable_stream {
         m_socket(std::make_shared<socket_type>(endpoint)),
         m_socket_watcher(reactor.native()),
         m_reactor(reactor),
-        m_tx_offset(0),
-        m_wr_offset(0)
+        m_pending(0),
+        m_low_watermark(buffer_pool().policy().low_watermark),
+        m_high_watermark(buffer_pool().policy().high_watermark),
+        m_congested(false),
+        m_corked(0),
+        m_scheduled(false)
     {
         m_socket_watcher.set<writable_stream, &writable_stream::on_event>(this);
-        m_ring.resize(65536);
     }
 
     writable_stream(reactor_t& reactor, const std::shared_ptr<socket_type>& socket):
         m_socket(socket),
         m_socket_watcher(reactor.native()),
         m_reactor(reactor),
-        m_tx_offset(0),
-        m_wr_offset(0)
+        m_pending(0),
+        m_low_watermark(buffer_pool().policy().low_watermark),
+        m_high_watermark(buffer_pool().policy().high_watermark),
+        m_congested(false),
+        m_corked(0),
+        m_scheduled(false)
     {
         m_socket_watcher.set<writable_stream, &writable_stream::on_event>(this);
-        m_ring.resize(65536);
     }
 
     template<class ErrorHandler>
@@ -62,79 +81,272 @@ struct writable_stream {
         m_handle_error = error_handler;
     }
 
+    // The pressure handler is invoked with true once the pending data exceeds the high watermark,
+    // and with false once it drops below the low watermark. It might be called from the writing
+    // thread, and never with the stream's lock held.
+
+    template<class PressureHandler>
+    void
+    watch(PressureHandler pressure_handler) {
+        m_handle_pressure = pressure_handler;
+    }
+
+    void
+    watermarks(size_t low, size_t high) {
+        std::lock_guard<std::mutex> guard(m_queue_mutex);
+
+        m_low_watermark = low;
+        m_high_watermark = high;
+    }
+
     void
     unbind() {
         m_handle_error = nullptr;
+        m_handle_pressure = nullptr;
+    }
+
+    bool
+    congested() const {
+        std::lock_guard<std::mutex> guard(m_queue_mutex);
+        return m_congested;
     }
 
     size_t
     footprint() const {
-        return m_ring.size();
+        std::lock_guard<std::mutex> guard(m_queue_mutex);
+
+        size_t footprint = m_spare ? m_spare->capacity() : 0;
+
+        for(auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+            footprint += it->buffer->capacity();
+        }
+
+        return footprint;
     }
 
-    struct deferred_wakeup_action {
-        void
-        operator()() const { }
-    };
+    // While the stream is corked, small writes are only queued and then sent all at once by the
+    // socket watcher, so that everything written during a single loop iteration goes out with a
+    // single syscall. Uncorking flushes the queue right away, so it must be done in the reactor
+    // thread. Corks might be nested.
+
+    void
+    cork() {
+        std::lock_guard<std::mutex> guard(m_queue_mutex);
+        ++m_corked;
+    }
+
+    void
+    uncork() {
+        std::unique_lock<std::mutex> lock(m_queue_mutex);
+
+        if(--m_corked != 0 || m_queue.empty()) {
+            return;
+        }
+
+        flush(lock);
+    }
 
     void
     write(const char* data, size_t size) {
-        std::unique_lock<std::mutex> m_lock(m_ring_mutex);
+        const iovec vector = { const_cast<char*>(data), size };
+
+        write(&vector, 1);
+    }
+
+    // Gathering write. The data is referenced only for the duration of this call: whatever the
+    // socket accepts right away is never copied, and only the remaining part is queued.
+
+    void
+    write(const iovec* vector, size_t count) {
+        std::unique_lock<std::mutex> m_lock(m_queue_mutex);
 
-        if(m_tx_offset == m_wr_offset) {
+        size_t sent = 0;
+
+        // NOTE: Large writes would be copied into the queue for nothing, so they are attempted
+        // right away even if the stream is corked.
+        const bool deferred = m_corked && length(vector, count) < cork_threshold;
+
+        if(m_queue.empty() && !deferred) {
             std::error_code ec;
 
-            // Nothing is pending in the ring so try to write directly to the socket, and enqueue
+            // Nothing is pending in the queue so try to write directly to the socket, and enqueue
             // only the remaining part, if any. Ignore any errors here.
-            ssize_t sent = m_socket->write(data, size, ec);
-
-            if(sent > 0) {
-                if(static_cast<size_t>(sent) == size) {
-                    return;
-                }
+            ssize_t length = m_socket->write(vector, std::min<size_t>(count, max_vector_size), ec);
 
-                data += sent;
-                size -= sent;
+            if(length > 0) {
+                sent = length;
             }
         }
 
-        while(m_ring.size() - m_wr_offset < size) {
-            size_t pending = m_wr_offset - m_tx_offset;
+        for(size_t i = 0; i < count; ++i) {
+            const char* data = static_cast<const char*>(vector[i].iov_base);
+            size_t size = vector[i].iov_len;
 
-            if(pending + size > m_ring.size() / 2) {
-                m_ring.resize(m_ring.size() * 2);
+            if(sent >= size) {
+                sent -= size;
                 continue;
             }
 
-            // There's no space left at the end of the buffer, so copy all the unsent
-            // data to the beginning and continue filling it from there.
-            std::memmove(m_ring.data(), m_ring.data() + m_tx_offset, pending);
+            enqueue(data + sent, size - sent);
 
-            m_wr_offset = pending;
-            m_tx_offset = 0;
+            sent = 0;
         }
 
-        std::memcpy(m_ring.data() + m_wr_offset, data, size);
+        if(!m_queue.empty() && !m_socket_watcher.is_active() && !m_scheduled) {
+            // NOTE: The writer might be running in some other thread, so the watcher is started
+            // in the reactor thread, at the beginning of its next loop iteration.
+            m_scheduled = true;
 
-        m_wr_offset += size;
+            m_reactor.post(std::bind(
+                &writable_stream::deferred_start,
+                std::weak_ptr<writable_stream>(this->shared_from_this())
+            ));
+        }
 
-        if(!m_socket_watcher.is_active()) {
-            m_socket_watcher.start(m_socket->fd(), ev::WRITE);
-            m_reactor.post(deferred_wakeup_action());
+        if(m_congested || !m_high_watermark || m_pending < m_high_watermark) {
+            return;
+        }
+
+        m_congested = true;
+
+        m_lock.unlock();
+
+        if(m_handle_pressure) {
+            m_handle_pressure(true);
         }
     }
 
 private:
+    typedef std::vector<char> buffer_type;
+
+    // Pending data is kept as a queue of segments, each owning a buffer along with the slice of
+    // it which is still to be sent. Small writes are coalesced into the last segment, while large
+    // ones get a buffer of their own, so that the pending data is never moved around once it's
+    // been queued. Every write is copied into the queue.
+
+    struct segment_t {
+        std::unique_ptr<buffer_type> buffer;
+
+        size_t offset,
+               size;
+    };
+
+    enum constants: size_t {
+        segment_size = 65536,
+        cork_threshold = 4096,
+#if defined(IOV_MAX)
+        max_vector_size = IOV_MAX
+#else
+        max_vector_size = 1024
+#endif
+    };
+
+    void
+    enqueue(const char* data, size_t size) {
+        if(!m_queue.empty()) {
+            segment_t& tail = m_queue.back();
+
+            const bool coalescable = tail.offset + tail.size == tail.buffer->size() &&
+                                     tail.buffer->capacity() - tail.buffer->size() >= size;
+
+            if(coalescable) {
+                tail.buffer->insert(tail.buffer->end(), data, data + size);
+                tail.size += size;
+                m_pending += size;
+
+                return;
+            }
+        }
+
+        std::unique_ptr<buffer_type> buffer;
+
+        if(size < segment_size / 2 && m_spare) {
+            buffer = std::move(m_spare);
+        } else {
+            buffer.reset(new buffer_type());
+            buffer->reserve(std::max<size_t>(size, segment_size));
+        }
+
+        buffer->assign(data, data + size);
+
+        m_queue.push_back(segment_t { std::move(buffer), 0, size });
+        m_pending += size;
+    }
+
+    void
+    consume(size_t size) {
+        m_pending -= size;
+
+        while(size) {
+            segment_t& head = m_queue.front();
+
+            if(size < head.size) {
+                head.offset += size;
+                head.size -= size;
+
+                return;
+            }
+
+            size -= head.size;
+
+            if(!m_spare && head.buffer->capacity() <= segment_size) {
+                // Keep one regular buffer around to avoid reallocating it on the next burst.
+                m_spare = std::move(head.buffer);
+                m_spare->clear();
+            }
+
+            m_queue.pop_front();
+        }
+    }
+
+    static
+    void
+    deferred_start(const std::weak_ptr<writable_stream>& stream) {
+        auto ptr = stream.lock();
+
+        if(!ptr) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(ptr->m_queue_mutex);
+
+        ptr->m_scheduled = false;
+
+        if(!ptr->m_queue.empty() && !ptr->m_socket_watcher.is_active()) {
+            ptr->m_socket_watcher.start(ptr->m_socket->fd(), ev::WRITE);
+        }
+    }
+
+    static
+    size_t
+    length(const iovec* vector, size_t count) {
+        size_t total = 0;
+
+        for(size_t i = 0; i < count; ++i) {
+            total += vector[i].iov_len;
+        }
+
+        return total;
+    }
+
     void
     on_event(ev::io& /* io */, int /* revents */) {
+        std::unique_lock<std::mutex> lock(m_queue_mutex);
+
+        flush(lock);
+    }
+
+    void
+    flush(std::unique_lock<std::mutex>& lock) {
         std::error_code ec;
-        std::unique_lock<std::mutex> lock(m_ring_mutex);
 
-        ssize_t sent = m_socket->write(
-            m_ring.data() + m_tx_offset,
-            m_wr_offset - m_tx_offset,
-            ec
-        );
+        m_vector.clear();
+
+        for(auto it = m_queue.begin(); it != m_queue.end() && m_vector.size() < max_vector_size; ++it) {
+            m_vector.push_back(iovec { it->buffer->data() + it->offset, it->size });
+        }
+
+        ssize_t sent = m_socket->write(m_vector.data(), m_vector.size(), ec);
 
         if(ec) {
             m_reactor.post(std::bind(m_handle_error, ec));
@@ -142,12 +354,24 @@ private:
         }
 
         if(sent > 0) {
-            m_tx_offset += sent;
+            consume(sent);
 
-            if(m_tx_offset == m_wr_offset) {
+            if(m_queue.empty()) {
                 m_socket_watcher.stop();
             }
         }
+
+        if(!m_congested || m_pending > m_low_watermark) {
+            return;
+        }
+
+        m_congested = false;
+
+        lock.unlock();
+
+        if(m_handle_pressure) {
+            m_handle_pressure(false);
+        }
     }
 
 private:
@@ -159,18 +383,38 @@ private:
     // Needed for asynchronous watcher control.
     reactor_t& m_reactor;
 
-    // Ring buffer.
-    std::vector<char> m_ring;
+    // Pending segments.
+    std::deque<segment_t> m_queue;
+    std::unique_ptr<buffer_type> m_spare;
+
+    size_t m_pending;
 
-    off_t m_tx_offset,
-          m_wr_offset;
+    // Backpressure thresholds.
+    size_t m_low_watermark,
+           m_high_watermark;
 
-    std::mutex m_ring_mutex;
+    bool m_congested;
+
+    // Cork nesting depth.
+    size_t m_corked;
+
+    // Whether the socket watcher is about to be started in the reactor thread.
+    bool m_scheduled;
+
+    // Scatter vector, reused between flushes.
+    std::vector<iovec> m_vector;
+
+    mutable std::mutex m_queue_mutex;
 
     // Write error handler.
     std::function<
         void(const std::error_code&)
     > m_handle_error;
+
+    // Backpressure handler.
+    std::function<
+        void(bool)
+    > m_handle_pressure;
 };
 
 }} // namespace cocaine::io
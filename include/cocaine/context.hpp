@@ -33,6 +33,9 @@ namespace cocaine {
 struct defaults {
     // Default profile.
     static const bool log_output;
+    static const bool deadline_first;
+    static const bool sticky_routing;
+    static const bool adaptive_concurrency;
     static const float heartbeat_timeout;
     static const float idle_timeout;
     static const float startup_timeout;
@@ -41,10 +44,19 @@ struct defaults {
     static const unsigned long queue_limit;
     static const unsigned long concurrency;
     static const unsigned long crashlog_limit;
+    static const unsigned long engine_threads;
+    static const unsigned long pool_minimum;
+    static const float spawn_rate;
 
     // Default I/O policy.
     static const float control_timeout;
     static const unsigned decoder_granularity;
+    static const unsigned long buffer_size;
+    static const unsigned long buffer_limit;
+    static const unsigned long buffer_reserve;
+    static const float buffer_timeout;
+    static const unsigned long low_watermark;
+    static const unsigned long high_watermark;
 
     // Default paths.
     static const char plugins_path[];
@@ -91,6 +103,23 @@ struct config_t {
         boost::optional<component_t> gateway;
     } network;
 
+    struct {
+        // NOTE: Read buffers start small, grow up to the limit and are returned to the shared
+        // buffer pool when the stream stays idle for the specified timeout.
+        unsigned long initial_size;
+        unsigned long size_limit;
+        unsigned long pool_limit;
+        float idle_timeout;
+
+        // NOTE: Write backpressure thresholds for the outgoing data of a single connection.
+        unsigned long low_watermark;
+        unsigned long high_watermark;
+
+        // NOTE: Maximum number of messages decoded from a single connection buffer before
+        // yielding to the other connections served by the same thread.
+        unsigned long granularity;
+    } buffers;
+
     typedef std::map<
         std::string,
         component_t
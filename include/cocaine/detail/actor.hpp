@@ -26,6 +26,8 @@
 #include "cocaine/asio/reactor.hpp"
 #include "cocaine/asio/tcp.hpp"
 
+#include "cocaine/detail/atomic.hpp"
+
 #include <list>
 #include <thread>
 
@@ -33,6 +35,10 @@ namespace cocaine {
 
 class dispatch_t;
 
+namespace detail {
+    struct recycler_t;
+}
+
 class actor_t {
     COCAINE_DECLARE_NONCOPYABLE(actor_t)
 
@@ -56,6 +62,12 @@ class actor_t {
         dispatch_t&
         dispatch();
 
+        // Number of messages decoded from all the client channels so far. Per-channel counts are
+        // kept by the channel decoders, but the channels are short-lived and keyed by descriptors
+        // which get reused, so only the total is reported.
+        uint64_t
+        processed() const;
+
     private:
         void
         on_connection(const std::shared_ptr<io::socket<io::tcp>>& socket);
@@ -66,6 +78,12 @@ class actor_t {
         void
         on_failure(int fd, const std::error_code& ec);
 
+        void
+        on_pressure(int fd, bool congested);
+
+        void
+        on_congestion(int fd);
+
     private:
         const std::unique_ptr<logging::log_t> m_log;
         const std::shared_ptr<io::reactor_t> m_reactor;
@@ -82,6 +100,14 @@ class actor_t {
 
         std::unique_ptr<dispatch_t> m_dispatch;
 
+        // Number of messages processed per channel in one go.
+        const unsigned long m_granularity;
+
+        std::atomic<uint64_t> m_processed;
+
+        // Upstream memory, recycled across all the channels.
+        const std::shared_ptr<detail::recycler_t> m_upstreams;
+
         // Actor I/O connectors
 
         std::list<
@@ -0,0 +1,174 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_ENGINE_CACHE_HPP
+#define COCAINE_ENGINE_CACHE_HPP
+
+#include "cocaine/common.hpp"
+
+#include "cocaine/api/stream.hpp"
+
+#include "cocaine/detail/atomic.hpp"
+#include "cocaine/detail/manifest.hpp"
+
+#include "json/json.h"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace cocaine { namespace engine {
+
+// Response cache for pure events. Requests for the cached events are buffered until the client
+// closes them, and then either answered right from the cache or passed on to the engine, in which
+// case the response stream is captured up to the choke. Identical requests arriving while the
+// response is still being streamed share the same slave invocation.
+
+class response_cache_t:
+    public std::enable_shared_from_this<response_cache_t>
+{
+    COCAINE_DECLARE_NONCOPYABLE(response_cache_t)
+
+    public:
+        typedef std::function<
+            std::shared_ptr<api::stream_t>(const api::event_t&, const std::shared_ptr<api::stream_t>&)
+        > backend_type;
+
+    public:
+        response_cache_t(const std::map<std::string, cache_policy_t>& policies, const backend_type& backend);
+
+        bool
+        cacheable(const std::string& event) const {
+            return m_policies.find(event) != m_policies.end();
+        }
+
+        // Returns the downstream for the request, which is looked up in the cache when closed.
+        std::shared_ptr<api::stream_t>
+        enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream);
+
+        // Disconnects the cache from the engine, the requests are rejected from now on.
+        void
+        detach();
+
+        Json::Value
+        info() const;
+
+    private:
+        struct request_t;
+        struct capture_t;
+
+        struct entry_t {
+            entry_t(size_t key_, const std::string& event_, const std::string& blob_):
+                key(key_),
+                event(event_),
+                blob(blob_),
+                size(0),
+                expires(0.0f),
+                state(states::pending)
+            { }
+
+            enum class states {
+                pending,
+                ready,
+                // The response is not going to be cached, but it's still streamed to the followers.
+                discarded
+            };
+
+            const size_t key;
+            const std::string event;
+            const std::string blob;
+
+            // Response chunks, captured so far.
+            std::vector<std::string> chunks;
+            size_t size;
+
+            double expires;
+            states state;
+
+            // Identical requests waiting for the response.
+            std::vector<std::shared_ptr<api::stream_t>> followers;
+
+            std::mutex mutex;
+        };
+
+        void
+        lookup(const api::event_t& event, const std::string& blob, const std::shared_ptr<api::stream_t>& upstream);
+
+        // Passes the request on to the engine. If it fails, the upstream is notified and an empty
+        // downstream is returned.
+        std::shared_ptr<api::stream_t>
+        dispatch(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream);
+
+        void
+        complete(const std::shared_ptr<entry_t>& entry);
+
+        void
+        discard(const std::shared_ptr<entry_t>& entry);
+
+        // Evicts the expired responses of the event, and then the oldest ones until the event fits
+        // into its memory limit. Cache lock must be held.
+        void
+        evict(const std::string& event, uint64_t limit, double timestamp);
+
+        // Removes the entry from the cache, if it's still there. Cache lock must be held.
+        void
+        erase(const std::shared_ptr<entry_t>& entry);
+
+        static
+        size_t
+        hash(const std::string& event, const std::string& blob);
+
+        static
+        double
+        now();
+
+    private:
+        const std::map<std::string, cache_policy_t> m_policies;
+
+        backend_type m_backend;
+
+        // Guards the backend only, so that the engine isn't detached during a submission.
+        std::mutex m_backend_mutex;
+
+        typedef std::map<
+            size_t,
+            std::shared_ptr<entry_t>
+        > entry_map_t;
+
+        entry_map_t m_entries;
+
+        // Cached entries of every event in the order they were cached in, for eviction.
+        std::map<std::string, std::deque<std::shared_ptr<entry_t>>> m_order;
+
+        // Memory taken by the cached responses of every event.
+        std::map<std::string, uint64_t> m_usage;
+
+        mutable std::mutex m_mutex;
+
+        // Statistics.
+
+        std::atomic<uint64_t> m_hits;
+        std::atomic<uint64_t> m_misses;
+        std::atomic<uint64_t> m_coalesced;
+};
+
+}} // namespace cocaine::engine
+
+#endif
@@ -34,6 +34,8 @@
 #include "json/json.h"
 
 #include <mutex>
+#include <set>
+#include <thread>
 
 #include <boost/mpl/list.hpp>
 
@@ -72,8 +74,13 @@ struct protocol<control_tag> {
 
 } // namespace io
 
+namespace detail {
+    struct recycler_t;
+}
+
 namespace engine {
 
+class response_cache_t;
 class slave_t;
 
 class engine_t {
@@ -112,37 +119,110 @@ class engine_t {
                 const std::shared_ptr<api::stream_t>& upstream,
                 const std::string& tag);
 
+        // Enqueues a batch of untagged events with a single engine wakeup. A downstream is returned
+        // for every event, or an empty pointer if the event didn't fit into the queue.
+        std::vector<std::shared_ptr<api::stream_t>>
+        enqueue(const std::vector<std::pair<api::event_t, std::shared_ptr<api::stream_t>>>& batch);
+
         void
         erase(const std::string& id, int code, const std::string& reason);
 
+        // Updates the slave's position in the load index, should be called by the slave whenever
+        // its load or state changes.
+        void
+        reindex(slave_t& slave);
+
+        // Autoscaler feedback from the slaves, durations are in seconds.
+
+        void
+        record_startup(double duration);
+
+        void
+        record_service(double duration);
+
+        // Whether the pool has more slaves than the configured warm minimum.
+        bool
+        surplus();
+
     private:
+        struct shard_t;
+
         void
-        on_connection(const std::shared_ptr<io::socket<io::local>>& socket);
+        on_connection(shard_t& shard, const std::shared_ptr<io::socket<io::local>>& socket);
 
         void
-        on_handshake(int fd, const io::message_t& message);
+        on_handshake(shard_t& shard, int fd, const io::message_t& message);
 
         void
-        on_disconnect(int fd, const std::error_code& ec);
+        on_disconnect(shard_t& shard, int fd, const std::error_code& ec);
 
         void
         on_control(const io::message_t& message);
 
+        void
+        on_erase(int code, const std::string& reason);
+
         void
         on_notification(ev::async&, int);
 
         void
         on_termination(ev::timer&, int);
 
+        void
+        on_deadline(ev::timer&, int);
+
+        void
+        on_scaling(ev::timer&, int);
+
         void
         pump();
 
+        void
+        expire();
+
+        slave_t*
+        select();
+
+        slave_t*
+        route(const std::string& tag);
+
+        // Enqueues an untagged session, bypassing the response cache.
+        std::shared_ptr<api::stream_t>
+        submit(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream);
+
+        std::shared_ptr<session_t>
+        create(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream);
+
+        void
+        queue(const std::shared_ptr<session_t>& session);
+
+        std::shared_ptr<api::stream_t>
+        downstream(const std::shared_ptr<session_t>& session);
+
+        void
+        unindex(const slave_t* slave);
+
+        void
+        unring(const slave_t* slave);
+
         void
         balance();
 
+        void
+        shrink();
+
+        size_t
+        estimate();
+
+        std::shared_ptr<slave_t>
+        spawn(const std::string& id);
+
         void
         migrate(states target);
 
+        void
+        abort();
+
         void
         stop();
 
@@ -163,30 +243,82 @@ class engine_t {
 
         std::shared_ptr<io::reactor_t> m_reactor;
 
+        // Slave processes are spawned in a dedicated thread, as it might block for a while.
+
+        std::shared_ptr<io::reactor_t> m_spawner;
+        std::unique_ptr<std::thread> m_spawner_thread;
+
         ev::async m_notification;
         ev::timer m_termination_timer;
+        ev::timer m_deadline_timer;
+        ev::timer m_scaling_timer;
 
         // I/O
 
-        std::unique_ptr<io::connector<io::acceptor<io::local>>> m_connector;
         std::unique_ptr<io::channel<io::socket<io::local>>> m_channel;
 
+        // Slave pool shards, each with its own reactor, thread and endpoint. With a single
+        // shard, the slaves share the engine reactor and no extra threads are started.
+
+        std::vector<std::unique_ptr<shard_t>> m_shards;
+
         // Session tagging
 
         std::atomic<uint64_t> m_next_id;
 
+        // Session and downstream memory, recycled across all the requests, so that the steady state
+        // session lifecycle doesn't hit the heap.
+
+        const std::shared_ptr<detail::recycler_t> m_sessions;
+        const std::shared_ptr<detail::recycler_t> m_downstreams;
+
+        // Response cache for the pure events, if configured in the manifest.
+
+        std::shared_ptr<response_cache_t> m_cache;
+
         // Session queue
 
         session_queue_t m_queue;
 
-        // Slave pool
+        // Autoscaling measurements, updated from any thread and collected on each autoscaler tick.
+        // Durations are accumulated in microseconds.
 
-        typedef std::map<
-            int,
-            std::shared_ptr<io::channel<io::socket<io::local>>>
-        > backlog_t;
+        std::atomic<uint64_t> m_arrivals;
+        std::atomic<uint64_t> m_activations;
+        std::atomic<uint64_t> m_startup_time;
+        std::atomic<uint64_t> m_completions;
+        std::atomic<uint64_t> m_service_time;
+
+        // Autoscaling estimates and decisions, touched only by the engine thread.
+
+        struct scaling_t {
+            ev::tstamp timestamp;
 
-        backlog_t m_backlog;
+            // The tick when the service time was first measured, or zero if it wasn't yet.
+            ev::tstamp measured;
+
+            // The tick since which the pool has been larger than the estimate, or zero if it's not.
+            ev::tstamp surplus;
+
+            // Smoothed arrival rate, in sessions per second, and its rate of change.
+            double arrival_rate;
+            double arrival_trend;
+
+            // Smoothed session service time and slave startup time, in seconds.
+            double service_time;
+            double startup_time;
+
+            // Spawn rate limiter tokens.
+            double spawn_budget;
+
+            // The latest pool size estimate and the decision made upon it.
+            size_t target;
+            std::string decision;
+        };
+
+        scaling_t m_scaling;
+
+        // Slave pool
 
         typedef std::map<
             std::string,
@@ -198,6 +330,31 @@ class engine_t {
         // Spawning mutex.
         std::mutex m_pool_mutex;
 
+        // Load index of the active slaves which can accept more sessions, ordered by load, and
+        // the load each of them is currently indexed with. Slaves can only be destroyed after
+        // being removed from the pool, which also removes them from the index.
+
+        typedef std::set<
+            std::pair<size_t, slave_t*>
+        > load_index_t;
+
+        load_index_t m_index;
+        std::map<const slave_t*, size_t> m_index_keys;
+
+        // Consistent hashing ring of the active slaves, with a number of virtual nodes for each of
+        // them, for sticky session routing. Guarded by the index mutex as well.
+
+        typedef std::map<
+            size_t,
+            slave_t*
+        > ring_t;
+
+        ring_t m_ring;
+        std::set<const slave_t*> m_ring_members;
+
+        // Index mutex, never held while acquiring other locks.
+        std::mutex m_index_mutex;
+
         // NOTE: A strong isolate reference, keeping it here
         // avoids isolate destruction, as the factory stores
         // only weak references to the isolate instances.
@@ -0,0 +1,241 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_FLAT_MAP_HPP
+#define COCAINE_FLAT_MAP_HPP
+
+#include "cocaine/common.hpp"
+
+#include <iterator>
+#include <vector>
+
+namespace cocaine { namespace detail {
+
+// Open addressing hash map with linear probing for non-zero integer keys, like session IDs. It's
+// stored in a single flat array, so lookups neither allocate nor chase pointers. Monotonic keys are
+// spread across the slots modulo the capacity, so they barely ever collide. Erasing shifts the
+// following entries back instead of leaving tombstones.
+
+template<class T>
+class flat_map {
+    public:
+        typedef uint64_t key_type;
+        typedef T mapped_type;
+        typedef std::pair<key_type, mapped_type> value_type;
+
+        template<class Value>
+        class basic_iterator:
+            public std::iterator<std::forward_iterator_tag, Value>
+        {
+            friend class flat_map;
+
+            public:
+                basic_iterator():
+                    m_ptr(nullptr),
+                    m_end(nullptr)
+                { }
+
+                Value&
+                operator*() const {
+                    return *m_ptr;
+                }
+
+                Value*
+                operator->() const {
+                    return m_ptr;
+                }
+
+                basic_iterator&
+                operator++() {
+                    ++m_ptr;
+                    skip();
+                    return *this;
+                }
+
+                bool
+                operator==(const basic_iterator& other) const {
+                    return m_ptr == other.m_ptr;
+                }
+
+                bool
+                operator!=(const basic_iterator& other) const {
+                    return m_ptr != other.m_ptr;
+                }
+
+            private:
+                basic_iterator(Value* ptr, Value* end):
+                    m_ptr(ptr),
+                    m_end(end)
+                {
+                    skip();
+                }
+
+                void
+                skip() {
+                    while(m_ptr != m_end && m_ptr->first == 0) {
+                        ++m_ptr;
+                    }
+                }
+
+            private:
+                Value* m_ptr;
+                Value* m_end;
+        };
+
+        typedef basic_iterator<value_type> iterator;
+        typedef basic_iterator<const value_type> const_iterator;
+
+    public:
+        explicit
+        flat_map(size_t capacity = 8):
+            m_size(0)
+        {
+            size_t slots = 8;
+
+            // Keep the load factor at one half at most.
+            while(slots < capacity * 2) {
+                slots *= 2;
+            }
+
+            m_slots.resize(slots);
+        }
+
+        iterator
+        begin() {
+            return iterator(m_slots.data(), m_slots.data() + m_slots.size());
+        }
+
+        iterator
+        end() {
+            return iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size());
+        }
+
+        const_iterator
+        begin() const {
+            return const_iterator(m_slots.data(), m_slots.data() + m_slots.size());
+        }
+
+        const_iterator
+        end() const {
+            return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size());
+        }
+
+        size_t
+        size() const {
+            return m_size;
+        }
+
+        bool
+        empty() const {
+            return m_size == 0;
+        }
+
+        iterator
+        find(key_type key) {
+            const size_t mask = m_slots.size() - 1;
+
+            for(size_t i = key & mask; m_slots[i].first != 0; i = (i + 1) & mask) {
+                if(m_slots[i].first == key) {
+                    return iterator(&m_slots[i], m_slots.data() + m_slots.size());
+                }
+            }
+
+            return end();
+        }
+
+        std::pair<iterator, bool>
+        insert(const value_type& value) {
+            BOOST_ASSERT(value.first != 0);
+
+            if((m_size + 1) * 2 > m_slots.size()) {
+                rehash(m_slots.size() * 2);
+            }
+
+            const size_t mask = m_slots.size() - 1;
+
+            size_t i = value.first & mask;
+
+            for(; m_slots[i].first != 0; i = (i + 1) & mask) {
+                if(m_slots[i].first == value.first) {
+                    return std::make_pair(iterator(&m_slots[i], m_slots.data() + m_slots.size()), false);
+                }
+            }
+
+            m_slots[i] = value;
+            ++m_size;
+
+            return std::make_pair(iterator(&m_slots[i], m_slots.data() + m_slots.size()), true);
+        }
+
+        void
+        erase(iterator it) {
+            const size_t mask = m_slots.size() - 1;
+
+            size_t hole = it.m_ptr - m_slots.data();
+
+            m_slots[hole] = value_type();
+            --m_size;
+
+            // Shift back the entries which would become unreachable because of the new hole.
+            for(size_t i = (hole + 1) & mask; m_slots[i].first != 0; i = (i + 1) & mask) {
+                const size_t home = m_slots[i].first & mask;
+
+                // NOTE: The entry can stay if its home slot is cyclically within (hole, i].
+                if(hole <= i ? (hole < home && home <= i) : (hole < home || home <= i)) {
+                    continue;
+                }
+
+                m_slots[hole] = std::move(m_slots[i]);
+                m_slots[i] = value_type();
+
+                hole = i;
+            }
+        }
+
+        void
+        clear() {
+            std::fill(m_slots.begin(), m_slots.end(), value_type());
+            m_size = 0;
+        }
+
+    private:
+        void
+        rehash(size_t slots) {
+            std::vector<value_type> previous(slots);
+
+            previous.swap(m_slots);
+
+            m_size = 0;
+
+            for(auto it = previous.begin(); it != previous.end(); ++it) {
+                if(it->first != 0) {
+                    insert(*it);
+                }
+            }
+        }
+
+    private:
+        std::vector<value_type> m_slots;
+        size_t m_size;
+};
+
+}} // namespace cocaine::detail
+
+#endif
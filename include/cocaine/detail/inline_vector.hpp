@@ -0,0 +1,173 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_INLINE_VECTOR_HPP
+#define COCAINE_INLINE_VECTOR_HPP
+
+#include "cocaine/common.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+namespace cocaine { namespace detail {
+
+// Vector of POD elements, which keeps up to N of them inline and only spills over to
+// the heap when it grows further. Short lived objects embedding it, like sessions, don't allocate
+// anything as long as their contents are small.
+
+template<class T, size_t N>
+class inline_vector {
+    COCAINE_DECLARE_NONCOPYABLE(inline_vector)
+
+    static_assert(std::is_pod<T>::value, "element type must be a POD");
+
+    public:
+        typedef T value_type;
+        typedef T* iterator;
+        typedef const T* const_iterator;
+
+    public:
+        inline_vector():
+            m_data(m_inline),
+            m_size(0),
+            m_capacity(N)
+        { }
+
+       ~inline_vector() {
+            if(m_data != m_inline) {
+                delete[] m_data;
+            }
+        }
+
+        iterator
+        begin() {
+            return m_data;
+        }
+
+        iterator
+        end() {
+            return m_data + m_size;
+        }
+
+        const_iterator
+        begin() const {
+            return m_data;
+        }
+
+        const_iterator
+        end() const {
+            return m_data + m_size;
+        }
+
+        T*
+        data() {
+            return m_data;
+        }
+
+        const T*
+        data() const {
+            return m_data;
+        }
+
+        T&
+        back() {
+            return m_data[m_size - 1];
+        }
+
+        size_t
+        size() const {
+            return m_size;
+        }
+
+        size_t
+        capacity() const {
+            return m_capacity;
+        }
+
+        bool
+        empty() const {
+            return m_size == 0;
+        }
+
+        void
+        push_back(const T& value) {
+            reserve(m_size + 1);
+            m_data[m_size++] = value;
+        }
+
+        // Appends a range of elements.
+        void
+        append(const T* first, size_t count) {
+            reserve(m_size + count);
+            std::memcpy(m_data + m_size, first, count * sizeof(T));
+            m_size += count;
+        }
+
+        // NOTE: The capacity is retained, so that a spilled over buffer is allocated only once.
+        void
+        clear() {
+            m_size = 0;
+        }
+
+        // Drops the elements along with the spilled over buffer, if any, going back to the inline
+        // storage.
+        void
+        reset() {
+            if(m_data != m_inline) {
+                delete[] m_data;
+            }
+
+            m_data = m_inline;
+            m_size = 0;
+            m_capacity = N;
+        }
+
+        void
+        reserve(size_t capacity) {
+            if(capacity <= m_capacity) {
+                return;
+            }
+
+            while(m_capacity < capacity) {
+                m_capacity *= 2;
+            }
+
+            T* data = new T[m_capacity];
+
+            std::memcpy(data, m_data, m_size * sizeof(T));
+
+            if(m_data != m_inline) {
+                delete[] m_data;
+            }
+
+            m_data = data;
+        }
+
+    private:
+        T m_inline[N];
+        T* m_data;
+
+        size_t m_size;
+        size_t m_capacity;
+};
+
+}} // namespace cocaine::detail
+
+#endif
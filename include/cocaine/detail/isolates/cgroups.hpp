@@ -0,0 +1,67 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_CGROUPS_ISOLATE_HPP
+#define COCAINE_CGROUPS_ISOLATE_HPP
+
+#include "cocaine/detail/isolates/process.hpp"
+
+namespace cocaine { namespace isolate {
+
+// Cgroups isolate spawns the slaves as plain processes and then places them into a dedicated cgroup
+// v2 group per app, with CPU and memory limits configured from the isolate arguments.
+
+class cgroups_t:
+    public api::isolate_t
+{
+    public:
+        cgroups_t(context_t& context, const std::string& name, const Json::Value& args);
+
+        virtual
+       ~cgroups_t();
+
+        virtual
+        std::unique_ptr<api::handle_t>
+        spawn(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe);
+
+        virtual
+        Json::Value
+        info() const;
+
+    private:
+        void
+        write(const std::string& file, const std::string& value) const;
+
+        std::string
+        read(const std::string& file) const;
+
+    private:
+        const std::unique_ptr<logging::log_t> m_log;
+
+        // The app cgroup path.
+        std::string m_path;
+
+        // Slaves are spawned by the process isolate.
+        process_t m_process;
+};
+
+}} // namespace cocaine::isolate
+
+#endif
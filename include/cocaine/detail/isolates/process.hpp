@@ -23,6 +23,10 @@
 
 #include "cocaine/api/isolate.hpp"
 
+#include <mutex>
+
+#include <sys/types.h>
+
 namespace cocaine { namespace isolate {
 
 class process_t:
@@ -38,9 +42,43 @@ class process_t:
         std::unique_ptr<api::handle_t>
         spawn(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe);
 
+        // Spawns the slave process, which has to be attached to a handle afterwards. If a cgroup is
+        // given as an open directory, the slave is placed into it before executing. Unless the C
+        // library can spawn into a cgroup, this means that the slave is always forked then.
+        pid_t
+        start(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe,
+              int cgroup = -1);
+
+        static
+        std::unique_ptr<api::handle_t>
+        attach(pid_t pid);
+
+    private:
+        pid_t
+        fork(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe,
+             int cgroup);
+
+        pid_t
+        launch(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe,
+               int cgroup);
+
     private:
         const std::unique_ptr<logging::log_t> m_log;
         const std::string m_working_directory;
+
+        // Whether to use posix_spawn() instead of fork() and execve().
+        bool m_posix_spawn;
+
+        // The slave environment is built once and reused for all the spawns with the same app
+        // environment, so that it's not copied over and over again. It's rebuilt when the daemon
+        // environment changes, which is detected by the entries of 'environ' it was built from.
+
+        api::string_map_t m_environment;
+        std::vector<char*> m_environ;
+        std::vector<std::string> m_envp_storage;
+        std::vector<char*> m_envp;
+
+        std::mutex m_mutex;
 };
 
 }} // namespace cocaine::isolate
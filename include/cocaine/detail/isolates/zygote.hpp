@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_ZYGOTE_ISOLATE_HPP
+#define COCAINE_ZYGOTE_ISOLATE_HPP
+
+#include "cocaine/api/isolate.hpp"
+
+#include <mutex>
+
+#include <sys/types.h>
+
+namespace cocaine { namespace isolate {
+
+// Zygote isolate starts a single template process per app, which is expected to load the app code
+// and then fork already initialized slaves on demand. The template is executed with an additional
+// '--zygote <fd>' argument, which is a sequenced packet socket to receive the fork requests on.
+//
+// Each request is a single packet with the slave arguments, serialized as a sequence of
+// NUL-terminated key and value strings, carrying the slave's output pipe descriptor as ancillary
+// data. The template replies with a packet containing the native pid_t of the forked slave, or a
+// negated errno value on failure. The forked slaves are reaped by the template.
+//
+// Slaves are terminated via the same socket with a packet consisting of the '--terminate' key and
+// the slave's pid as its value, without any ancillary data. The template is expected to send
+// SIGTERM to the slave, if it's still its unreaped child, and not to reply. The template itself is
+// executed with the app-wide arguments only, and its output goes to the isolate log.
+//
+// When the template is restarted, the slaves it has forked are orphaned, so termination requests
+// for them are served by sending SIGKILL directly instead.
+
+class zygote_t:
+    public api::isolate_t,
+    public std::enable_shared_from_this<zygote_t>
+{
+    public:
+        zygote_t(context_t& context, const std::string& name, const Json::Value& args);
+
+        virtual
+       ~zygote_t();
+
+        virtual
+        std::unique_ptr<api::handle_t>
+        spawn(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe);
+
+        // Asks the template which has forked the slave to terminate it.
+        void
+        terminate(pid_t pid, uint64_t generation);
+
+    private:
+        void
+        start(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment);
+
+        void
+        stop();
+
+        pid_t
+        fork(const api::string_map_t& args, int pipe);
+
+        // Logs whatever the template has written to its output so far.
+        void
+        drain();
+
+    private:
+        const std::unique_ptr<logging::log_t> m_log;
+        const std::string m_working_directory;
+
+        // Maximum time to wait for the template to reply, including its own startup.
+        const float m_timeout;
+
+        // The template process, its control socket and its output pipe.
+        pid_t m_pid;
+        int m_socket;
+        int m_output;
+
+        // Incremented on every template restart, so that the slaves of a dead template are not
+        // confused with the ones of the current template.
+        uint64_t m_generation;
+
+        std::mutex m_mutex;
+};
+
+}} // namespace cocaine::isolate
+
+#endif
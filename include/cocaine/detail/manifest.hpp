@@ -29,6 +29,14 @@
 
 namespace cocaine { namespace engine {
 
+struct cache_policy_t {
+    // How long the cached responses are valid, in seconds.
+    float ttl;
+
+    // Maximum size of the cached responses of an event, in bytes.
+    uint64_t limit;
+};
+
 struct manifest_t:
     cached<Json::Value>
 {
@@ -52,6 +60,9 @@ struct manifest_t:
 
     // Disables the publication of this app via the Locator.
     bool local;
+
+    // Events with pure responses, which are cached by the engine, keyed by the event name.
+    std::map<std::string, cache_policy_t> cache;
 };
 
 }} // namespace cocaine::engine
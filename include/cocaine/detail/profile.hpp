@@ -40,6 +40,17 @@ struct profile_t:
     // Copy all the slave output to the runtime log.
     bool log_output;
 
+    // Schedule the queued sessions in the earliest deadline first order.
+    bool deadline_first;
+
+    // Tune the concurrency of each slave within the configured limit, based on the observed
+    // session latency.
+    bool adaptive_concurrency;
+
+    // Route the tagged sessions to the active slaves by consistent hashing of their tags, instead
+    // of spawning a dedicated slave for each tag.
+    bool sticky_routing;
+
     // Timeouts.
     float heartbeat_timeout;
     float idle_timeout;
@@ -49,10 +60,18 @@ struct profile_t:
     // Limits.
     unsigned long concurrency;
     unsigned long crashlog_limit;
+    unsigned long decoder_granularity;
+    unsigned long engine_threads;
     unsigned long grow_threshold;
     unsigned long pool_limit;
     unsigned long queue_limit;
 
+    // Autoscaling.
+    unsigned long pool_minimum;
+
+    // Slave spawns per second, not limited if zero.
+    float spawn_rate;
+
     // NOTE: The slave processes are launched in sandboxed environments,
     // called isolates. This one describes the isolate type and arguments.
     config_t::component_t isolate;
@@ -21,34 +21,125 @@
 #ifndef COCAINE_ENGINE_QUEUE_HPP
 #define COCAINE_ENGINE_QUEUE_HPP
 
-#include <deque>
+#include "cocaine/common.hpp"
+
+#include "cocaine/detail/atomic.hpp"
+#include "cocaine/detail/recycler.hpp"
+
+#include <map>
 #include <memory>
-#include <mutex>
+#include <vector>
 
 namespace cocaine { namespace engine {
 
 struct session_t;
 
-struct session_queue_t:
-    public std::deque<std::shared_ptr<session_t>>
-{
-    void
-    push(const_reference session);
+// Session queue with two lanes, one for urgent sessions and one for normal sessions. It can be
+// pushed to from any thread without locking, but only a single consumer thread is allowed to pop
+// sessions from it. Each lane is either FIFO or ordered by the session deadlines.
+
+class session_queue_t {
+    COCAINE_DECLARE_NONCOPYABLE(session_queue_t)
+
+    public:
+        typedef std::shared_ptr<session_t> value_type;
+
+    public:
+        session_queue_t(bool deadline_first);
+       ~session_queue_t();
+
+        // Producer interface
+
+        void
+        push(const value_type& session);
+
+        // NOTE: The size is approximate, as it might be updated concurrently.
+
+        size_t
+        size() const {
+            return m_size.load(std::memory_order_relaxed);
+        }
+
+        bool
+        empty() const {
+            return size() == 0;
+        }
+
+        // Consumer interface
+
+        bool
+        pop(value_type& session);
+
+        // Puts the session back to its original position.
+        void
+        requeue(const value_type& session);
+
+        // Moves out the sessions whose deadline is due by the specified time.
+        void
+        expire(double now, std::vector<value_type>& expired);
+
+        // The earliest deadline of the queued sessions, or zero if there's none.
+        double
+        deadline() const;
+
+    private:
+        struct node_t {
+            value_type session;
+            node_t* next;
+        };
+
+        // Sessions are ordered by their deadline, if the queue is deadline-first, and then by ID,
+        // which reflects the enqueueing order.
+        typedef std::pair<double, uint64_t> key_type;
+
+        // NOTE: Map nodes are recycled, as every queued session passes through these maps.
+        typedef std::map<
+            key_type,
+            value_type,
+            std::less<key_type>,
+            detail::recycling_allocator<std::pair<const key_type, value_type>>
+        > session_map_t;
+
+        struct lane_t {
+            lane_t(const session_map_t::allocator_type& allocator):
+                stack(nullptr),
+                pending(std::less<key_type>(), allocator)
+            { }
+
+            // Intrusive lock-free stack, pushed by any thread and swapped out by the consumer.
+            std::atomic<node_t*> stack;
+
+            // Sessions taken from the stack, in order. Touched only by the consumer.
+            session_map_t pending;
+        };
+
+        key_type
+        key(const value_type& session) const;
+
+        lane_t&
+        lane(const value_type& session);
+
+        void
+        collect(lane_t& source);
+
+        void
+        insert(const value_type& session);
+
+    private:
+        const bool m_deadline_first;
 
-    // Lockable concept implementation
+        // Map node memory, so that ordering the sessions doesn't allocate. It's only touched by the
+        // consumer, while the stack nodes are allocated on the heap, so that the producers never
+        // share anything but the stack head.
+        const std::shared_ptr<detail::recycler_t> m_entries;
 
-    void
-    lock() {
-        m_mutex.lock();
-    }
+        lane_t m_urgent;
+        lane_t m_normal;
 
-    void
-    unlock() {
-        m_mutex.unlock();
-    }
+        // Deadline index of the sessions taken from the stacks. Touched only by the consumer.
+        session_map_t m_deadlines;
 
-private:
-    std::mutex m_mutex;
+        std::atomic<size_t> m_size;
 };
 
 }} // namespace cocaine::engine
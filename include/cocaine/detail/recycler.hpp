@@ -0,0 +1,171 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_RECYCLER_HPP
+#define COCAINE_RECYCLER_HPP
+
+#include "cocaine/common.hpp"
+
+#include <mutex>
+
+namespace cocaine { namespace detail {
+
+// Thread-safe free list of equally sized memory blocks. Objects which are created at a high rate,
+// but might be destroyed on some other thread, e.g. client upstreams, are allocated from it, so
+// that the heap is not hit for every one of them once the free list is warmed up.
+//
+// NOTE: The free list never blocks. When it's contended, the block is taken from or given back to
+// the heap instead, so that the allocating threads are never serialized on it.
+
+struct recycler_t {
+    COCAINE_DECLARE_NONCOPYABLE(recycler_t)
+
+    recycler_t(size_t limit):
+        m_block_size(0),
+        m_limit(limit)
+    { }
+
+   ~recycler_t() {
+        for(auto it = m_free.begin(); it != m_free.end(); ++it) {
+            ::operator delete(*it);
+        }
+    }
+
+    void*
+    allocate(size_t size) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+
+        if(lock.owns_lock()) {
+            if(size == m_block_size && !m_free.empty()) {
+                void* block = m_free.back();
+                m_free.pop_back();
+                return block;
+            }
+
+            lock.unlock();
+        }
+
+        return ::operator new(size);
+    }
+
+    void
+    deallocate(void* block, size_t size) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+
+        if(lock.owns_lock()) {
+            if(m_block_size == 0) {
+                // NOTE: The first released block defines the block size for the rest of them.
+                m_block_size = size;
+            }
+
+            if(size == m_block_size && m_free.size() < m_limit) {
+                m_free.push_back(block);
+                return;
+            }
+
+            lock.unlock();
+        }
+
+        ::operator delete(block);
+    }
+
+private:
+    size_t m_block_size;
+
+    // Maximum number of retained blocks.
+    const size_t m_limit;
+
+    std::vector<void*> m_free;
+    std::mutex m_mutex;
+};
+
+// Allocator adapter, mostly for std::allocate_shared(). Allocator copies share the recycler, so it
+// stays alive for as long as there are objects allocated from it.
+
+template<class T>
+struct recycling_allocator {
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind {
+        typedef recycling_allocator<U> other;
+    };
+
+    recycling_allocator(const std::shared_ptr<recycler_t>& recycler_):
+        recycler(recycler_)
+    { }
+
+    template<class U>
+    recycling_allocator(const recycling_allocator<U>& other):
+        recycler(other.recycler)
+    { }
+
+    pointer
+    allocate(size_type count, const void* /* hint */ = nullptr) {
+        return static_cast<pointer>(recycler->allocate(count * sizeof(T)));
+    }
+
+    void
+    deallocate(pointer ptr, size_type count) {
+        recycler->deallocate(ptr, count * sizeof(T));
+    }
+
+    template<class U, typename... Args>
+    void
+    construct(U* ptr, Args&&... args) {
+        ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    template<class U>
+    void
+    destroy(U* ptr) {
+        ptr->~U();
+    }
+
+    size_type
+    max_size() const {
+        return static_cast<size_type>(-1) / sizeof(T);
+    }
+
+public:
+    std::shared_ptr<recycler_t> recycler;
+};
+
+template<class T, class U>
+bool
+operator==(const recycling_allocator<T>& lhs, const recycling_allocator<U>& rhs) {
+    return lhs.recycler == rhs.recycler;
+}
+
+template<class T, class U>
+bool
+operator!=(const recycling_allocator<T>& lhs, const recycling_allocator<U>& rhs) {
+    return lhs.recycler != rhs.recycler;
+}
+
+}} // namespace cocaine::detail
+
+#endif
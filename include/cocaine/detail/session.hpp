@@ -73,6 +73,10 @@ struct session_t {
     void
     close();
 
+    // Notifies the slave that the session is no longer needed and closes it.
+    void
+    cancel(int code, const std::string& reason);
+
 public:
     // Session ID.
     const uint64_t id;
@@ -83,15 +87,18 @@ public:
     // Client's upstream for response delivery.
     const std::shared_ptr<api::stream_t> upstream;
 
+    // The time the session has been assigned to a slave at.
+    ev::tstamp started;
+
 private:
     template<class Event, typename... Args>
     void
     send(Args&&... args);
 
 private:
-    std::unique_ptr<
-        io::encoder<io::writable_stream<io::socket<io::local>>>
-    > m_encoder;
+    // NOTE: The encoder is embedded, so that the session and its message buffer are allocated as
+    // a single block, which is then recycled by the engine.
+    io::encoder<io::writable_stream<io::socket<io::local>>> m_encoder;
 
     // Session interlocking.
     std::mutex m_mutex;
@@ -110,7 +117,7 @@ session_t::send(Args&&... args) {
     std::lock_guard<std::mutex> lock(m_mutex);
 
     if(m_state == state::open) {
-        m_encoder->write<Event>(id, std::forward<Args>(args)...);
+        m_encoder.write<Event>(id, std::forward<Args>(args)...);
     } else {
         throw cocaine::error_t("the session is no longer valid");
     }
@@ -29,9 +29,11 @@
 #include "cocaine/asio/reactor.hpp"
 
 #include "cocaine/detail/atomic.hpp"
-#include "cocaine/detail/queue.hpp"
+#include "cocaine/detail/flat_map.hpp"
 
 #include <chrono>
+#include <deque>
+#include <set>
 
 #include <boost/circular_buffer.hpp>
 
@@ -39,7 +41,9 @@ namespace cocaine { namespace engine {
 
 struct session_t;
 
-class slave_t {
+class slave_t:
+    public std::enable_shared_from_this<slave_t>
+{
     COCAINE_DECLARE_NONCOPYABLE(slave_t)
 
     enum class states {
@@ -58,6 +62,12 @@ class slave_t {
 
        ~slave_t();
 
+        // Spawns the slave process asynchronously in the specified reactor's thread, the slave
+        // will then connect to the given endpoint. The slave's watchers are set up in its own
+        // reactor's thread, so this can be called from any thread.
+        void
+        launch(const std::string& endpoint, io::reactor_t& spawner);
+
         // I/O
 
         void
@@ -73,10 +83,19 @@ class slave_t {
         void
         stop();
 
+        // Stops accepting new sessions and deactivates the slave once the active ones are done.
+        void
+        drain();
+
     public:
         bool
         active() const {
-            return m_state == states::active;
+            return m_state == states::active && !m_draining;
+        }
+
+        bool
+        draining() const {
+            return m_draining;
         }
 
         size_t
@@ -84,7 +103,30 @@ class slave_t {
             return m_sessions.size();
         }
 
+        // The current concurrency limit, which is adaptive if enabled in the profile.
+        size_t
+        limit() const {
+            return m_limit;
+        }
+
+        // Number of messages received from the slave.
+        uint64_t
+        processed() const;
+
+        io::reactor_t&
+        reactor() const {
+            return m_reactor;
+        }
+
+        const std::string&
+        id() const {
+            return m_id;
+        }
+
     private:
+        void
+        on_spawn(const std::shared_ptr<api::handle_t>& handle, const std::string& reason);
+
         void
         on_message(const io::message_t& message);
 
@@ -100,7 +142,7 @@ class slave_t {
         on_death(int code, const std::string& reason);
 
         void
-        on_chunk(uint64_t session_id, const std::string& chunk);
+        on_chunk(uint64_t session_id, const char* chunk, size_t size);
 
         void
         on_error(uint64_t session_id, int code, const std::string& reason);
@@ -108,6 +150,24 @@ class slave_t {
         void
         on_choke(uint64_t session_id);
 
+        // Backpressure
+
+        void
+        on_pressure(uint64_t session_id, bool congested);
+
+        // Adaptive concurrency
+
+        void
+        adapt(double latency);
+
+        // Session timeouts
+
+        void
+        on_expiration(uint64_t session_id, ev::tstamp deadline);
+
+        void
+        on_deadline(ev::timer&, int);
+
         // Health
 
         void
@@ -124,9 +184,29 @@ class slave_t {
         void
         pump();
 
+        static
+        void
+        deferred_pump(const std::weak_ptr<slave_t>& slave);
+
+        static
+        void
+        deferred_stop(const std::weak_ptr<slave_t>& slave);
+
+        static
+        void
+        deferred_launch(const std::weak_ptr<slave_t>& slave, const std::string& endpoint, io::reactor_t& spawner);
+
+        void
+        start(const std::string& endpoint, io::reactor_t& spawner);
+
         void
         dump();
 
+        // Deactivates the slave and asks the worker to shut down gracefully, unless the slave isn't
+        // active anymore. Must be called in the slave's reactor thread.
+        void
+        retire(const std::string& reason);
+
         void
         terminate(int code, const std::string& reason);
 
@@ -153,7 +233,22 @@ class slave_t {
 
         // Health
 
-        states m_state;
+        // NOTE: The state is changed in the slave's reactor thread, but it's also checked by the
+        // engine when selecting slaves for sessions.
+        std::atomic<states> m_state;
+
+        // Set by the engine when the slave is no longer needed.
+        std::atomic<bool> m_draining;
+
+        // Adaptive concurrency limit, along with its AIMD state, which is touched only by the
+        // slave's own thread.
+
+        std::atomic<size_t> m_limit;
+
+        double m_window;
+        double m_baseline;
+        ev::tstamp m_adapted;
+        bool m_probing;
 
 #if defined(__clang__) || defined(HAVE_GCC47)
         const std::chrono::steady_clock::time_point m_birthstamp;
@@ -166,7 +261,9 @@ class slave_t {
 
         // Native handle
 
-        std::unique_ptr<api::handle_t> m_handle;
+        struct spawn_action_t;
+
+        std::shared_ptr<api::handle_t> m_handle;
 
         // Output capture
 
@@ -175,26 +272,48 @@ class slave_t {
         std::unique_ptr<io::readable_stream<pipe_t>> m_output_pipe;
         boost::circular_buffer<std::string> m_output_ring;
 
+        // Whether the rest of the current output line is being dropped.
+        bool m_output_truncated;
+
         // I/O channel
 
         std::shared_ptr<io::channel<io::socket<io::local>>> m_channel;
 
-        // Active sessions
+        // Backpressure
+
+        struct pressure_t;
+
+        // Sessions whose clients can't keep up with the slave.
+        std::set<uint64_t> m_congested;
+
+        // Session timeouts
 
-        typedef std::map<
-            uint64_t,
+        struct expiration_t;
+
+        // In-flight session deadlines. Completed sessions are dropped from here lazily.
+        std::set<std::pair<ev::tstamp, uint64_t>> m_deadlines;
+
+        ev::timer m_deadline_timer;
+
+        // Active sessions, sized for the profile concurrency, so that it never has to grow.
+
+        typedef detail::flat_map<
             std::shared_ptr<session_t>
         > session_map_t;
 
         session_map_t m_sessions;
 
-        // Tagged session queue
+        // Tagged session queue, guarded by the slave mutex
+
+        typedef std::deque<
+            std::shared_ptr<session_t>
+        > pending_queue_t;
 
-        session_queue_t m_queue;
+        pending_queue_t m_queue;
 
         // Slave interlocking
 
-        std::mutex m_mutex;
+        mutable std::mutex m_mutex;
 };
 
 }} // namespace cocaine::engine
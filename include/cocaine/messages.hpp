@@ -105,6 +105,24 @@ namespace app {
     struct info {
         typedef app_tag tag;
     };
+
+    struct enqueue_batch {
+        typedef app_tag tag;
+
+        typedef boost::mpl::list<
+         /* Batch entries, each being an [event, data] or an [event, data, tag] tuple, with the same
+            meaning as the enqueue arguments. All of them are enqueued with a single engine wakeup. */
+            std::vector<std::tuple<std::string, std::string, std::string>>
+        > tuple_type;
+
+        typedef
+         /* Responses of all the entries multiplexed into a single stream. Every chunk is a packed
+            array, which is either [index, chunk] for a response chunk of the entry with the given
+            index, [index, code, reason] for an entry error, or [index] once the entry is completed.
+            The stream is closed when all the entries are completed. */
+            raw_t
+        result_type;
+    };
 }
 
 template<>
@@ -115,7 +133,8 @@ struct protocol<app_tag> {
 
     typedef boost::mpl::list<
         app::enqueue,
-        app::info
+        app::info,
+        app::enqueue_batch
     > type;
 };
 
@@ -23,19 +23,194 @@
 
 #include "cocaine/rpc/message.hpp"
 
+#include "cocaine/detail/atomic.hpp"
+
+#include <algorithm>
 #include <functional>
 
 namespace cocaine { namespace io {
 
+namespace detail {
+
+// Resumable msgpack frame scanner. It walks the frame structure without building any objects and
+// keeps its progress between reads, so that every byte is looked at exactly once no matter how many
+// reads it takes for the frame to arrive. The progress is stored as an offset from the beginning of
+// the frame, so it survives the buffer being moved around in between.
+
+struct frame_scanner_t {
+    frame_scanner_t() {
+        reset();
+    }
+
+    void
+    reset() {
+        m_offset = 0;
+        m_stack.assign(1, 1);
+    }
+
+    // Returns the size of the frame at the beginning of the data, or zero if it is incomplete.
+    size_t
+    scan(const char* data, size_t size) {
+        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(data);
+
+        while(!m_stack.empty()) {
+            if(m_offset >= size) {
+                return 0;
+            }
+
+            const unsigned char type = ptr[m_offset];
+
+            size_t header = 1;
+            uint64_t length = 0;
+            uint64_t items = 0;
+
+            if(type <= 0x7F || type >= 0xE0) {
+                // Fixed integers.
+            } else if(type <= 0x8F) {
+                items = (type & 0x0F) * 2;
+            } else if(type <= 0x9F) {
+                items = type & 0x0F;
+            } else if(type <= 0xBF) {
+                length = type & 0x1F;
+            } else {
+                switch(type) {
+                case 0xC0: case 0xC2: case 0xC3:
+                    break;
+                case 0xC4: case 0xD9:
+                    header = 2;
+                    break;
+                case 0xC5: case 0xDA: case 0xDC: case 0xDE:
+                    header = 3;
+                    break;
+                case 0xC6: case 0xDB: case 0xDD: case 0xDF:
+                    header = 5;
+                    break;
+                case 0xC7:
+                    header = 3;
+                    break;
+                case 0xC8:
+                    header = 4;
+                    break;
+                case 0xC9:
+                    header = 6;
+                    break;
+                case 0xCA: case 0xCE: case 0xD2:
+                    length = 4;
+                    break;
+                case 0xCB: case 0xCF: case 0xD3:
+                    length = 8;
+                    break;
+                case 0xCC: case 0xD0:
+                    length = 1;
+                    break;
+                case 0xCD: case 0xD1:
+                    length = 2;
+                    break;
+                case 0xD4: case 0xD5: case 0xD6: case 0xD7: case 0xD8:
+                    length = 1 + (1 << (type - 0xD4));
+                    break;
+                default:
+                    throw std::system_error(make_error_code(rpc_errc::parse_error));
+                }
+
+                if(size - m_offset < header) {
+                    return 0;
+                }
+
+                switch(type) {
+                case 0xC4: case 0xD9:
+                    length = ptr[m_offset + 1];
+                    break;
+                case 0xC5: case 0xDA:
+                    length = load(ptr + m_offset + 1, 2);
+                    break;
+                case 0xC6: case 0xDB:
+                    length = load(ptr + m_offset + 1, 4);
+                    break;
+                case 0xC7:
+                    length = ptr[m_offset + 1];
+                    break;
+                case 0xC8:
+                    length = load(ptr + m_offset + 1, 2);
+                    break;
+                case 0xC9:
+                    length = load(ptr + m_offset + 1, 4);
+                    break;
+                case 0xDC:
+                    items = load(ptr + m_offset + 1, 2);
+                    break;
+                case 0xDD:
+                    items = load(ptr + m_offset + 1, 4);
+                    break;
+                case 0xDE:
+                    items = load(ptr + m_offset + 1, 2) * 2;
+                    break;
+                case 0xDF:
+                    items = load(ptr + m_offset + 1, 4) * 2;
+                    break;
+                }
+            }
+
+            if(size - m_offset < header + length) {
+                // NOTE: The element header will be decoded once again on the next read, but it's
+                // at most a few bytes, while the element body is never scanned.
+                return 0;
+            }
+
+            m_offset += header + length;
+
+            // The element itself completes one item of the enclosing container.
+            --m_stack.back();
+
+            if(items) {
+                m_stack.push_back(items);
+            }
+
+            while(!m_stack.empty() && m_stack.back() == 0) {
+                m_stack.pop_back();
+            }
+        }
+
+        const size_t frame = m_offset;
+
+        reset();
+
+        return frame;
+    }
+
+private:
+    static
+    uint64_t
+    load(const unsigned char* ptr, size_t size) {
+        uint64_t value = 0;
+
+        for(size_t i = 0; i < size; ++i) {
+            value = (value << 8) | ptr[i];
+        }
+
+        return value;
+    }
+
+private:
+    // Number of bytes of the current frame scanned so far.
+    size_t m_offset;
+
+    // Number of items left in each of the enclosing containers.
+    std::vector<uint64_t> m_stack;
+};
+
+} // namespace detail
+
 template<class Stream>
 struct decoder {
     COCAINE_DECLARE_NONCOPYABLE(decoder)
 
     typedef Stream stream_type;
 
-    decoder() {
-        // Empty.
-    }
+    decoder():
+        m_granularity(256),
+        m_processed(0)
+    { }
 
    ~decoder() {
         if(m_stream) {
@@ -46,6 +221,7 @@ struct decoder {
     void
     attach(const std::shared_ptr<stream_type>& stream) {
         m_stream = stream;
+        m_scanner.reset();
     }
 
     template<class MessageHandler, class ErrorHandler>
@@ -69,50 +245,55 @@ struct decoder {
         m_handle_message = nullptr;
     }
 
+    // Maximum number of messages processed in one go, before yielding to the other channels.
+    void
+    granularity(size_t messages) {
+        m_granularity = std::max<size_t>(messages, 1);
+    }
+
 public:
     std::shared_ptr<stream_type>
     stream() {
         return m_stream;
     }
 
+    uint64_t
+    processed() const {
+        return m_processed.load(std::memory_order_relaxed);
+    }
+
 private:
     size_t
     on_event(const char* data, size_t size) {
         size_t offset = 0,
-               checkpoint = 0,
                bulk = 0;
 
-        msgpack::unpack_return rv;
-        msgpack::zone zone;
-
         do {
-            msgpack::object object;
+            const size_t frame = m_scanner.scan(data + offset, size - offset);
 
-            rv = msgpack::unpack(data, size, &offset, &zone, &object);
+            if(!frame) {
+                return offset;
+            }
 
-            switch(rv) {
-            case msgpack::UNPACK_EXTRA_BYTES:
-            case msgpack::UNPACK_SUCCESS: {
-                checkpoint = offset;
+            msgpack::object object;
+            size_t unpacked = 0;
 
-                m_handle_message(message_t(object));
+            // NOTE: The frame is known to be complete, so it's parsed exactly once.
+            if(msgpack::unpack(data + offset, frame, &unpacked, &m_zone, &object) != msgpack::UNPACK_SUCCESS) {
+                throw std::system_error(make_error_code(rpc_errc::parse_error));
+            }
 
-                if(rv == msgpack::UNPACK_SUCCESS) {
-                    return size;
-                }
+            offset += frame;
 
-                if(++bulk == 256) {
-                    return checkpoint;
-                }
-            } break;
+            m_handle_message(message_t(object));
 
-            case msgpack::UNPACK_CONTINUE:
-                return checkpoint;
+            // The message is gone by now, so its zone memory can be reused.
+            m_zone.clear();
 
-            case msgpack::UNPACK_PARSE_ERROR:
-                throw std::system_error(make_error_code(rpc_errc::parse_error));
-            }
-        } while(true);
+            m_processed.fetch_add(1, std::memory_order_relaxed);
+        } while(offset != size && ++bulk != m_granularity);
+
+        return offset;
     }
 
 private:
@@ -122,6 +303,17 @@ private:
 
     // Attachable stream.
     std::shared_ptr<stream_type> m_stream;
+
+    // Frame boundary tracking.
+    detail::frame_scanner_t m_scanner;
+
+    // Unpacked object storage, reused between the messages.
+    msgpack::zone m_zone;
+
+    size_t m_granularity;
+
+    // Number of messages processed so far, for fairness accounting.
+    std::atomic<uint64_t> m_processed;
 };
 
 }}
@@ -23,10 +23,175 @@
 
 #include "cocaine/rpc/message.hpp"
 
+#include "cocaine/detail/inline_vector.hpp"
+
+#include "cocaine/traits/literal.hpp"
+
 #include <mutex>
 
+#include <boost/mpl/empty.hpp>
+
+#include <sys/uio.h>
+
 namespace cocaine { namespace io {
 
+namespace detail {
+
+// Packer stream which copies writes into an owned buffer, except for the large blobs explicitly
+// lent by the caller for the duration of the flush, which are only referenced, so that they could be
+// written to the socket right from where they are, e.g. a chunk forwarded from a slave is sent to the
+// client straight from the slave's read buffer. Anything else, like temporary strings produced while
+// packing, is always copied.
+
+struct gather_buffer_t {
+    enum constants: size_t {
+        borrow_threshold = 4096,
+        inline_size = 256,
+        inline_segments = 4,
+        // Owned buffers larger than this are released after the flush.
+        retain_limit = borrow_threshold * 4
+    };
+
+    void
+    write(const char* data, size_t size) {
+        if(size >= borrow_threshold && lent(data, size)) {
+            m_segments.push_back(segment_t { data, 0, size });
+            return;
+        }
+
+        if(m_segments.empty() || m_segments.back().data != nullptr) {
+            m_segments.push_back(segment_t { nullptr, m_owned.size(), 0 });
+        }
+
+        m_owned.append(data, size);
+        m_segments.back().size += size;
+    }
+
+    // The caller guarantees that the data stays valid until the buffer is flushed.
+    void
+    lend(const char* data, size_t size) {
+        m_lent.push_back(segment_t { data, 0, size });
+    }
+
+    template<class Stream>
+    void
+    flush(Stream& stream) {
+        if(m_segments.empty()) {
+            return;
+        }
+
+        m_vector.clear();
+
+        for(auto it = m_segments.begin(); it != m_segments.end(); ++it) {
+            const char* data = it->data ? it->data : m_owned.data() + it->offset;
+
+            m_vector.push_back(iovec { const_cast<char*>(data), it->size });
+        }
+
+        stream.write(m_vector.data(), m_vector.size());
+
+        // NOTE: This retains the capacity, so that the buffers are allocated only once, unless some
+        // rare large frame has blown up the owned buffer, which would otherwise be pinned for as long
+        // as the channel lives.
+        m_segments.clear();
+        m_lent.clear();
+
+        if(m_owned.capacity() > retain_limit) {
+            m_owned.reset();
+        } else {
+            m_owned.clear();
+        }
+    }
+
+private:
+    struct segment_t {
+        // Borrowed data, or nullptr if the segment lives in the owned buffer at some offset.
+        const char* data;
+        size_t offset;
+        size_t size;
+    };
+
+    bool
+    lent(const char* data, size_t size) const {
+        for(auto it = m_lent.begin(); it != m_lent.end(); ++it) {
+            if(it->data == data && it->size == size) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // NOTE: Small messages, like invocations and chokes, fit into the inline storage, so buffers
+    // embedded into short lived objects don't hit the heap at all.
+    cocaine::detail::inline_vector<segment_t, inline_segments> m_segments;
+    cocaine::detail::inline_vector<char, inline_size> m_owned;
+    cocaine::detail::inline_vector<iovec, inline_segments> m_vector;
+
+    // Blobs which might be referenced instead of being copied.
+    cocaine::detail::inline_vector<segment_t, inline_segments> m_lent;
+};
+
+// Precomputed frames for the events without arguments. Such a frame is always [ID, Tag, []], so
+// the only variable part is the tag, which is patched in. The event IDs are small, so the frame
+// prefix is a compile-time constant.
+
+template<class Event>
+struct constant_frame {
+    enum constants: size_t { id = event_traits<Event>::id, max_size = 16 };
+
+    static_assert(id < 128, "event id doesn't fit into a positive fixnum");
+
+    static
+    size_t
+    encode(uint64_t tag, char* target) {
+        unsigned char* ptr = reinterpret_cast<unsigned char*>(target);
+
+        // NOTE: Fixed array of 3 elements and the event ID as a positive fixnum.
+        *ptr++ = 0x93;
+        *ptr++ = static_cast<unsigned char>(id);
+
+        if(tag < 128) {
+            *ptr++ = static_cast<unsigned char>(tag);
+        } else if(tag < 0x100) {
+            *ptr++ = 0xCC;
+            ptr = store(ptr, tag, 1);
+        } else if(tag < 0x10000) {
+            *ptr++ = 0xCD;
+            ptr = store(ptr, tag, 2);
+        } else if(tag < 0x100000000ULL) {
+            *ptr++ = 0xCE;
+            ptr = store(ptr, tag, 4);
+        } else {
+            *ptr++ = 0xCF;
+            ptr = store(ptr, tag, 8);
+        }
+
+        // NOTE: Empty argument array.
+        *ptr++ = 0x90;
+
+        return ptr - reinterpret_cast<unsigned char*>(target);
+    }
+
+private:
+    static
+    unsigned char*
+    store(unsigned char* ptr, uint64_t value, size_t size) {
+        for(size_t i = size; i != 0; --i) {
+            *ptr++ = static_cast<unsigned char>(value >> ((i - 1) * 8));
+        }
+
+        return ptr;
+    }
+};
+
+template<class Event>
+struct is_constant:
+    public boost::mpl::empty<typename event_traits<Event>::tuple_type>
+{ };
+
+} // namespace detail
+
 template<class Stream>
 struct encoder {
     COCAINE_DECLARE_NONCOPYABLE(encoder)
@@ -47,10 +212,15 @@ struct encoder {
 
         m_stream = stream;
 
-        if(m_buffer.size() != 0) {
-            m_stream->write(m_buffer.data(), m_buffer.size());
-            m_buffer.clear();
-        }
+        // Nothing could've been borrowed while detached, so this just flushes the owned buffer.
+        m_buffer.flush(*m_stream);
+    }
+
+    void
+    detach() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_stream.reset();
     }
 
     template<class ErrorHandler>
@@ -59,18 +229,29 @@ struct encoder {
         m_stream->bind(error_handler);
     }
 
+    template<class PressureHandler>
+    void
+    watch(PressureHandler pressure_handler) {
+        m_stream->watch(pressure_handler);
+    }
+
     void
     unbind() {
         m_stream->unbind();
     }
 
     template<class Event, typename... Args>
-    void
+    typename std::enable_if<!detail::is_constant<Event>::value>::type
     write(uint64_t stream, Args&&... args) {
         typedef event_traits<Event> traits;
 
         std::lock_guard<std::mutex> guard(m_mutex);
 
+        // NOTE: Arguments can only be referenced if they are going to be flushed right away.
+        if(m_stream) {
+            lend(args...);
+        }
+
         // NOTE: Format is [ID, Tag, [Args...]].
         m_packer.pack_array(3);
 
@@ -83,8 +264,25 @@ struct encoder {
         );
 
         if(m_stream) {
-            m_stream->write(m_buffer.data(), m_buffer.size());
-            m_buffer.clear();
+            m_buffer.flush(*m_stream);
+        }
+    }
+
+    // Events without arguments are never packed, but copied from a precomputed frame instead.
+
+    template<class Event>
+    typename std::enable_if<detail::is_constant<Event>::value>::type
+    write(uint64_t stream) {
+        char frame[detail::constant_frame<Event>::max_size];
+
+        const size_t size = detail::constant_frame<Event>::encode(stream, frame);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(m_stream) {
+            m_stream->write(frame, size);
+        } else {
+            m_buffer.write(frame, size);
         }
     }
 
@@ -95,8 +293,31 @@ public:
     }
 
 private:
-    msgpack::sbuffer m_buffer;
-    msgpack::packer<msgpack::sbuffer> m_packer;
+    // Only literals are referenced by their owners, so they are the only arguments which could be
+    // lent to the buffer.
+
+    void
+    lend() { }
+
+    template<class Head, typename... Tail>
+    void
+    lend(const Head& head, const Tail&... tail) {
+        lend_argument(head);
+        lend(tail...);
+    }
+
+    void
+    lend_argument(const literal& argument) {
+        m_buffer.lend(argument.blob, argument.size);
+    }
+
+    template<class T>
+    void
+    lend_argument(const T& /* argument */) { }
+
+private:
+    detail::gather_buffer_t m_buffer;
+    msgpack::packer<detail::gather_buffer_t> m_packer;
 
     // Message buffer interlocking.
     std::mutex m_mutex;
@@ -40,11 +40,13 @@ struct type_traits<char[N]> {
     }
 };
 
-// Specialization to pack character arrays without copying to a std::string first.
+// Specialization to pack character arrays without copying to a std::string first. It can also be
+// used as an unpacking target, in which case it references the unpacked object's bytes, so it is
+// only valid for as long as the underlying buffer is, e.g. until the message handler returns.
 
 struct literal {
     const char * blob;
-    const size_t size;
+    size_t size;
 
     // This is needed to mark this struct as implicitly convertible to std::string, although this
     // conversion never takes place, only statically checked in the typelist traits.
@@ -60,6 +62,17 @@ struct type_traits<literal> {
         packer.pack_raw(source.size);
         packer.pack_raw_body(source.blob, source.size);
     }
+
+    static inline
+    void
+    unpack(const msgpack::object& unpacked, literal& target) {
+        if(unpacked.type != msgpack::type::RAW) {
+            throw msgpack::type_error();
+        }
+
+        target.blob = unpacked.via.raw.ptr;
+        target.size = unpacked.via.raw.size;
+    }
 };
 
 }} // namespace cocaine::io
@@ -28,6 +28,10 @@
 #include "cocaine/asio/socket.hpp"
 #include "cocaine/asio/tcp.hpp"
 
+#include "cocaine/context.hpp"
+
+#include "cocaine/detail/recycler.hpp"
+
 #include "cocaine/dispatch.hpp"
 #include "cocaine/logging.hpp"
 #include "cocaine/memory.hpp"
@@ -50,7 +54,8 @@ struct actor_t::lockable_type {
     friend class actor_t;
 
     lockable_type(std::unique_ptr<io::channel<io::socket<io::tcp>>>&& ptr_):
-        ptr(std::move(ptr_))
+        ptr(std::move(ptr_)),
+        congested(false)
     { }
 
 private:
@@ -61,10 +66,34 @@ private:
         // NOTE: This invalidates the internal channel pointer, but the wrapping lockable state
         // might still be accessible via upstreams in other threads.
         ptr.reset();
+
+        // Nobody will ever drain this channel, so release whoever is waiting for it.
+        if(congested) {
+            notify(false);
+        }
+
+        watchers.clear();
+    }
+
+    void
+    notify(bool congested_) {
+        congested = congested_;
+
+        for(auto it = watchers.begin(); it != watchers.end(); ++it) {
+            it->second(congested);
+        }
     }
 
     std::unique_ptr<io::channel<io::socket<io::tcp>>> ptr;
     std::mutex mutex;
+
+    // Backpressure subscribers, by upstream.
+    std::map<
+        const api::stream_t*,
+        api::stream_t::pressure_handler_t
+    > watchers;
+
+    bool congested;
 };
 
 struct actor_t::upstream_t:
@@ -76,6 +105,12 @@ struct actor_t::upstream_t:
         m_tag(tag)
     { }
 
+    virtual
+   ~upstream_t() {
+        std::lock_guard<std::mutex> guard(m_channel->mutex);
+        m_channel->watchers.erase(this);
+    }
+
     virtual
     void
     write(const char* chunk, size_t size) {
@@ -110,6 +145,27 @@ struct actor_t::upstream_t:
         }
     }
 
+    virtual
+    void
+    watch(const pressure_handler_t& handler) {
+        std::lock_guard<std::mutex> guard(m_channel->mutex);
+
+        if(!handler) {
+            m_channel->watchers.erase(this);
+            return;
+        }
+
+        if(!m_channel->ptr) {
+            return;
+        }
+
+        m_channel->watchers[this] = handler;
+
+        if(m_channel->congested) {
+            handler(true);
+        }
+    }
+
 private:
     struct state {
         enum value: int { open, closed };
@@ -125,7 +181,10 @@ private:
 actor_t::actor_t(context_t& context, std::shared_ptr<reactor_t> reactor, std::unique_ptr<dispatch_t>&& dispatch):
     m_log(new logging::log_t(context, dispatch->name())),
     m_reactor(reactor),
-    m_dispatch(std::move(dispatch))
+    m_dispatch(std::move(dispatch)),
+    m_granularity(context.config.buffers.granularity),
+    m_processed(0),
+    m_upstreams(std::make_shared<detail::recycler_t>(1024))
 { }
 
 actor_t::~actor_t() {
@@ -208,6 +267,11 @@ actor_t::dispatch() -> dispatch_t& {
     return *m_dispatch;
 }
 
+uint64_t
+actor_t::processed() const {
+    return m_processed.load(std::memory_order_relaxed);
+}
+
 void
 actor_t::on_connection(const std::shared_ptr<io::socket<tcp>>& socket_) {
     const int fd = socket_->fd();
@@ -218,6 +282,8 @@ actor_t::on_connection(const std::shared_ptr<io::socket<tcp>>& socket_) {
 
     auto ptr = std::make_unique<channel<io::socket<tcp>>>(*m_reactor, socket_);
 
+    ptr->rd->granularity(m_granularity);
+
     ptr->rd->bind(
         std::bind(&actor_t::on_message, this, fd, _1),
         std::bind(&actor_t::on_failure, this, fd, _1)
@@ -227,6 +293,14 @@ actor_t::on_connection(const std::shared_ptr<io::socket<tcp>>& socket_) {
         std::bind(&actor_t::on_failure, this, fd, _1)
     );
 
+    ptr->wr->watch(
+        std::bind(&actor_t::on_pressure, this, fd, _1)
+    );
+
+    // NOTE: Responses streamed back from the slaves usually consist of many small frames, so they
+    // are coalesced and sent to the client once per loop iteration.
+    ptr->wr->stream()->cork();
+
     m_channels[fd] = std::make_shared<lockable_type>(std::move(ptr));
 }
 
@@ -236,12 +310,56 @@ actor_t::on_message(int fd, const message_t& message) {
 
     BOOST_ASSERT(it != m_channels.end());
 
-    m_dispatch->invoke(message, std::make_shared<upstream_t>(
+    m_processed.fetch_add(1, std::memory_order_relaxed);
+
+    // NOTE: Upstreams are created for every request and usually die on some other thread after
+    // the response is sent, so they are recycled instead of being allocated on the heap.
+    m_dispatch->invoke(message, std::allocate_shared<upstream_t>(
+        detail::recycling_allocator<upstream_t>(m_upstreams),
         it->second,
         message.band()
     ));
 }
 
+void
+actor_t::on_pressure(int fd, bool /* congested */) {
+    // NOTE: This might be called from any thread writing into the channel, possibly with the
+    // channel lock held, so the subscribers are notified asynchronously on the actor's thread.
+    m_reactor->post(std::bind(&actor_t::on_congestion, this, fd));
+}
+
+void
+actor_t::on_congestion(int fd) {
+    auto it = m_channels.find(fd);
+
+    if(it == m_channels.end()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(it->second->mutex);
+
+    if(!it->second->ptr) {
+        return;
+    }
+
+    // NOTE: The actual stream state is used instead of the reported one, as the descriptor might
+    // have been reused by another client by the time this is called.
+    const bool congested = it->second->ptr->wr->stream()->congested();
+
+    if(congested == it->second->congested) {
+        return;
+    }
+
+    COCAINE_LOG_DEBUG(
+        m_log,
+        "client on fd %d is %s",
+        fd,
+        congested ? "congested, throttling its sessions" : "no longer congested"
+    );
+
+    it->second->notify(congested);
+}
+
 void
 actor_t::on_failure(int fd, const std::error_code& ec) {
     auto it = m_channels.find(fd);
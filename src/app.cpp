@@ -44,7 +44,9 @@
 #include "cocaine/rpc/channel.hpp"
 
 #include "cocaine/traits/json.hpp"
+#include "cocaine/traits/literal.hpp"
 
+#include <mutex>
 #include <tuple>
 
 #include <boost/bind.hpp>
@@ -68,10 +70,18 @@ struct app_t::service_t:
             m_self(self)
         { }
 
+        // NOTE: Same as the app::enqueue typelist, except that the blob is referenced right from the
+        // read buffer instead of being copied into a string.
+        typedef boost::mpl::list<
+            std::string,
+            literal,
+            optional<std::string>
+        > tuple_type;
+
         virtual
         void
         operator()(const msgpack::object& unpacked, const api::stream_ptr_t& upstream) {
-            io::detail::invoke<event_traits<app::enqueue>::tuple_type>::apply(
+            io::detail::invoke<tuple_type>::apply(
                 boost::bind(&service_t::enqueue, &m_self, upstream, _1, _2, _3),
                 unpacked
             );
@@ -81,17 +91,226 @@ struct app_t::service_t:
         app_t::service_t& m_self;
     };
 
+    struct enqueue_batch_slot_t:
+        public slot_concept_t
+    {
+        enqueue_batch_slot_t(app_t::service_t& self):
+            slot_concept_t("enqueue_batch"),
+            m_self(self)
+        { }
+
+        // NOTE: The entries are unpacked by hand, as their tags are optional and the blobs are
+        // referenced right from the read buffer, same as for the single enqueue.
+        virtual
+        void
+        operator()(const msgpack::object& unpacked, const api::stream_ptr_t& upstream) {
+            if(unpacked.type != msgpack::type::ARRAY ||
+               unpacked.via.array.size < 1 ||
+               unpacked.via.array.ptr[0].type != msgpack::type::ARRAY)
+            {
+                throw cocaine::error_t("argument sequence type mismatch");
+            }
+
+            const msgpack::object& entries = unpacked.via.array.ptr[0];
+
+            std::vector<entry_t> batch(entries.via.array.size);
+
+            for(size_t i = 0; i < batch.size(); ++i) {
+                const msgpack::object& entry = entries.via.array.ptr[i];
+
+                if(entry.type != msgpack::type::ARRAY ||
+                   entry.via.array.size < 2)
+                {
+                    throw cocaine::error_t("batch entry %d type mismatch", i);
+                }
+
+                type_traits<std::string>::unpack(entry.via.array.ptr[0], batch[i].event);
+                type_traits<literal>::unpack(entry.via.array.ptr[1], batch[i].blob);
+
+                if(entry.via.array.size > 2) {
+                    type_traits<std::string>::unpack(entry.via.array.ptr[2], batch[i].tag);
+                }
+            }
+
+            m_self.enqueue(upstream, batch);
+        }
+
+    private:
+        app_t::service_t& m_self;
+    };
+
     service_t(context_t& context, const std::string& name, app_t& app):
         dispatch_t(context, cocaine::format("service/%1%", name)),
         m_app(app)
     {
         on<app::enqueue>(std::make_shared<enqueue_slot_t>(*this));
         on<app::info>("info", std::bind(&app_t::info, std::ref(m_app)));
+        on<app::enqueue_batch>(std::make_shared<enqueue_batch_slot_t>(*this));
     }
 
 private:
+    struct entry_t {
+        std::string event;
+        literal blob;
+        std::string tag;
+    };
+
+    // Responses of the batch entries, multiplexed into the client's upstream. The upstream is
+    // closed once every entry is completed.
+
+    struct batch_t {
+        batch_t(const api::stream_ptr_t& upstream_, size_t size):
+            upstream(upstream_),
+            remaining(size),
+            packer(buffer)
+        { }
+
+        const api::stream_ptr_t upstream;
+        std::atomic<size_t> remaining;
+
+        // Frame buffer, shared by all the entries of the batch. Entries might be completed by
+        // different slaves at the same time, so it's guarded along with the upstream writes.
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> packer;
+
+        std::mutex mutex;
+    };
+
+    struct entry_upstream_t:
+        public api::stream_t
+    {
+        entry_upstream_t(const std::shared_ptr<batch_t>& batch, uint64_t index):
+            m_batch(batch),
+            m_index(index),
+            m_closed(false)
+        { }
+
+        virtual
+       ~entry_upstream_t() {
+            close();
+        }
+
+        virtual
+        void
+        write(const char* chunk, size_t size) {
+            send<boost::mpl::list<uint64_t, literal>>(m_index, literal { chunk, size });
+        }
+
+        virtual
+        void
+        error(int code, const std::string& reason) {
+            send<boost::mpl::list<uint64_t, int, std::string>>(m_index, code, reason);
+        }
+
+        virtual
+        void
+        close() {
+            if(m_closed.exchange(true)) {
+                return;
+            }
+
+            send<boost::mpl::list<uint64_t>>(m_index);
+
+            if(--m_batch->remaining == 0) {
+                m_batch->upstream->close();
+            }
+        }
+
+    private:
+        template<class Sequence, typename... Args>
+        void
+        send(const Args&... args) {
+            std::lock_guard<std::mutex> guard(m_batch->mutex);
+
+            m_batch->buffer.clear();
+
+            type_traits<Sequence>::pack(m_batch->packer, args...);
+
+            m_batch->upstream->write(m_batch->buffer.data(), m_batch->buffer.size());
+        }
+
+    private:
+        const std::shared_ptr<batch_t> m_batch;
+        const uint64_t m_index;
+
+        std::atomic<bool> m_closed;
+    };
+
     void
-    enqueue(const api::stream_ptr_t& upstream, const std::string& event, const std::string& blob, const std::string& tag) {
+    enqueue(const api::stream_ptr_t& upstream, const std::vector<entry_t>& entries) {
+        if(entries.empty()) {
+            upstream->close();
+            return;
+        }
+
+        auto batch = std::make_shared<batch_t>(upstream, entries.size());
+
+        std::vector<api::stream_ptr_t> upstreams;
+        std::vector<api::stream_ptr_t> downstreams(entries.size());
+
+        upstreams.reserve(entries.size());
+
+        // Untagged entries are handed over to the engine at once, while the tagged ones are
+        // assigned to their slaves one by one.
+        std::vector<std::pair<api::event_t, api::stream_ptr_t>> untagged;
+        std::vector<size_t> indices;
+
+        for(size_t i = 0; i < entries.size(); ++i) {
+            upstreams.push_back(std::make_shared<entry_upstream_t>(batch, i));
+
+            if(entries[i].tag.empty()) {
+                untagged.push_back(std::make_pair(api::event_t(entries[i].event), upstreams[i]));
+                indices.push_back(i);
+                continue;
+            }
+
+            try {
+                downstreams[i] = m_app.enqueue(api::event_t(entries[i].event), upstreams[i], entries[i].tag);
+            } catch(const cocaine::error_t& e) {
+                upstreams[i]->error(resource_error, e.what());
+                upstreams[i]->close();
+            }
+        }
+
+        if(!untagged.empty()) {
+            try {
+                std::vector<api::stream_ptr_t> queued = m_app.enqueue(untagged);
+
+                for(size_t i = 0; i < queued.size(); ++i) {
+                    if(!queued[i]) {
+                        upstreams[indices[i]]->error(resource_error, "the queue is full");
+                        upstreams[indices[i]]->close();
+                    }
+
+                    downstreams[indices[i]] = queued[i];
+                }
+            } catch(const cocaine::error_t& e) {
+                for(auto it = indices.begin(); it != indices.end(); ++it) {
+                    upstreams[*it]->error(resource_error, e.what());
+                    upstreams[*it]->close();
+                }
+            }
+        }
+
+        for(size_t i = 0; i < entries.size(); ++i) {
+            if(!downstreams[i]) {
+                continue;
+            }
+
+            // NOTE: A failing entry must not leave the rest of the batch hanging, so each one is
+            // handed over on its own.
+            try {
+                downstreams[i]->write(entries[i].blob.blob, entries[i].blob.size);
+                downstreams[i]->close();
+            } catch(const std::exception& e) {
+                upstreams[i]->error(invocation_error, e.what());
+                upstreams[i]->close();
+            }
+        }
+    }
+
+    void
+    enqueue(const api::stream_ptr_t& upstream, const std::string& event, const literal& blob, const std::string& tag) {
         api::stream_ptr_t downstream;
 
         try {
@@ -107,7 +326,7 @@ private:
             return;
         }
 
-        downstream->write(blob.data(), blob.size());
+        downstream->write(blob.blob, blob.size);
         downstream->close();
     }
 
@@ -119,7 +338,8 @@ app_t::app_t(context_t& context, const std::string& name, const std::string& pro
     m_context(context),
     m_log(new logging::log_t(context, cocaine::format("app/%1%", name))),
     m_manifest(new manifest_t(context, name)),
-    m_profile(new profile_t(context, profile))
+    m_profile(new profile_t(context, profile)),
+    m_service(nullptr)
 {
     const fs::path path = fs::path(m_context.config.path.spool) / name;
 
@@ -216,12 +436,19 @@ app_t::start() {
     if(!m_manifest->local) {
         COCAINE_LOG_DEBUG(m_log, "starting the invocation service");
 
-        // Publish the app service.
-        m_context.attach(m_manifest->name, std::make_unique<actor_t>(
+        auto service = std::make_unique<actor_t>(
             m_context,
             std::make_shared<reactor_t>(),
             std::make_unique<app_t::service_t>(m_context, m_manifest->name, *this)
-        ));
+        );
+
+        {
+            std::lock_guard<std::mutex> guard(m_service_mutex);
+            m_service = service.get();
+        }
+
+        // Publish the app service.
+        m_context.attach(m_manifest->name, std::move(service));
     }
 
     COCAINE_LOG_INFO(m_log, "the engine has started");
@@ -356,6 +583,12 @@ app_t::stop() {
     COCAINE_LOG_INFO(m_log, "stopping the engine");
 
     if(!m_manifest->local) {
+        {
+            // NOTE: The service is destroyed right away, so it must not be reported on anymore.
+            std::lock_guard<std::mutex> guard(m_service_mutex);
+            m_service = nullptr;
+        }
+
         // Stop the app service.
         m_context.detach(m_manifest->name);
     }
@@ -406,6 +639,15 @@ app_t::info() const {
 
     info["profile"] = m_profile->name;
 
+    {
+        std::lock_guard<std::mutex> guard(m_service_mutex);
+
+        if(m_service) {
+            // Slave channels are accounted for by the engine under 'slaves/processed'.
+            info["clients"]["processed"] = static_cast<Json::LargestUInt>(m_service->processed());
+        }
+    }
+
     for(auto it = m_drivers.begin(); it != m_drivers.end(); ++it) {
         info["drivers"][it->first] = it->second->info();
     }
@@ -423,6 +665,11 @@ app_t::enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t>&
     return m_engine->enqueue(event, upstream, tag);
 }
 
+std::vector<std::shared_ptr<api::stream_t>>
+app_t::enqueue(const std::vector<std::pair<api::event_t, std::shared_ptr<api::stream_t>>>& batch) {
+    return m_engine->enqueue(batch);
+}
+
 void
 app_t::deploy(const std::string& name, const std::string& path) {
     std::string blob;
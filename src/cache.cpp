@@ -0,0 +1,464 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/detail/cache.hpp"
+
+#include "cocaine/api/event.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace cocaine::engine;
+
+// Cached request
+
+struct response_cache_t::request_t:
+    public api::stream_t
+{
+    request_t(const std::shared_ptr<response_cache_t>& cache, const api::event_t& event, const api::stream_ptr_t& upstream):
+        m_cache(cache),
+        m_event(event),
+        m_upstream(upstream),
+        m_closed(false)
+    { }
+
+    virtual
+   ~request_t() {
+        close();
+    }
+
+    virtual
+    void
+    write(const char* chunk, size_t size) {
+        if(m_downstream) {
+            m_downstream->write(chunk, size);
+        } else {
+            m_blob.append(chunk, size);
+        }
+    }
+
+    virtual
+    void
+    error(int code, const std::string& reason) {
+        // NOTE: Failed requests bypass the cache, so the request is passed on to the engine as is.
+        if(!m_downstream) {
+            m_downstream = m_cache->dispatch(m_event, m_upstream);
+
+            if(!m_downstream) {
+                // NOTE: The upstream has been notified already, so there's nothing left to do.
+                m_closed = true;
+                return;
+            }
+
+            m_downstream->write(m_blob.data(), m_blob.size());
+        }
+
+        m_downstream->error(code, reason);
+    }
+
+    virtual
+    void
+    close() {
+        if(m_closed) {
+            return;
+        }
+
+        m_closed = true;
+
+        if(m_downstream) {
+            m_downstream->close();
+        } else {
+            m_cache->lookup(m_event, m_blob, m_upstream);
+        }
+    }
+
+private:
+    const std::shared_ptr<response_cache_t> m_cache;
+    const api::event_t m_event;
+    const api::stream_ptr_t m_upstream;
+
+    // Request data, buffered until the request is closed.
+    std::string m_blob;
+
+    api::stream_ptr_t m_downstream;
+
+    bool m_closed;
+};
+
+// Response capture
+
+struct response_cache_t::capture_t:
+    public api::stream_t
+{
+    capture_t(const std::shared_ptr<response_cache_t>& cache, const std::shared_ptr<entry_t>& entry, uint64_t limit,
+              const api::stream_ptr_t& upstream):
+        m_cache(cache),
+        m_entry(entry),
+        m_limit(limit),
+        m_upstream(upstream),
+        m_closed(false)
+    { }
+
+    virtual
+   ~capture_t() {
+        close();
+    }
+
+    virtual
+    void
+    write(const char* chunk, size_t size) {
+        bool discarded = false;
+
+        {
+            std::lock_guard<std::mutex> guard(m_entry->mutex);
+
+            if(m_entry->state == entry_t::states::pending) {
+                if(m_entry->size + size > m_limit) {
+                    // The response is too large to be cached, so it's only streamed from now on.
+                    m_entry->state = entry_t::states::discarded;
+                    m_entry->chunks.clear();
+
+                    discarded = true;
+                } else {
+                    m_entry->chunks.push_back(std::string(chunk, size));
+                    m_entry->size += size;
+                }
+            }
+
+            // NOTE: Followers are written to with the entry lock held, so that the ones joining
+            // midway get the captured chunks in order.
+            for(auto it = m_entry->followers.begin(); it != m_entry->followers.end(); ++it) {
+                (*it)->write(chunk, size);
+            }
+        }
+
+        if(discarded) {
+            m_cache->discard(m_entry);
+        }
+
+        m_upstream->write(chunk, size);
+    }
+
+    virtual
+    void
+    error(int code, const std::string& reason) {
+        {
+            std::lock_guard<std::mutex> guard(m_entry->mutex);
+
+            // Errors are never cached.
+            if(m_entry->state == entry_t::states::pending) {
+                m_entry->state = entry_t::states::discarded;
+                m_entry->chunks.clear();
+            }
+
+            for(auto it = m_entry->followers.begin(); it != m_entry->followers.end(); ++it) {
+                (*it)->error(code, reason);
+            }
+        }
+
+        m_cache->discard(m_entry);
+
+        m_upstream->error(code, reason);
+    }
+
+    virtual
+    void
+    close() {
+        if(m_closed) {
+            return;
+        }
+
+        m_closed = true;
+
+        m_cache->complete(m_entry);
+
+        m_upstream->close();
+    }
+
+private:
+    const std::shared_ptr<response_cache_t> m_cache;
+    const std::shared_ptr<entry_t> m_entry;
+    const uint64_t m_limit;
+    const api::stream_ptr_t m_upstream;
+
+    bool m_closed;
+};
+
+response_cache_t::response_cache_t(const std::map<std::string, cache_policy_t>& policies, const backend_type& backend):
+    m_policies(policies),
+    m_backend(backend),
+    m_hits(0),
+    m_misses(0),
+    m_coalesced(0)
+{ }
+
+std::shared_ptr<cocaine::api::stream_t>
+response_cache_t::enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream) {
+    return std::make_shared<request_t>(shared_from_this(), event, upstream);
+}
+
+void
+response_cache_t::detach() {
+    std::lock_guard<std::mutex> guard(m_backend_mutex);
+
+    m_backend = nullptr;
+}
+
+Json::Value
+response_cache_t::info() const {
+    Json::Value info(Json::objectValue);
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    uint64_t memory = 0;
+
+    for(auto it = m_usage.begin(); it != m_usage.end(); ++it) {
+        memory += it->second;
+    }
+
+    info["entries"] = static_cast<Json::LargestUInt>(m_entries.size());
+    info["memory"] = static_cast<Json::LargestUInt>(memory);
+    info["hits"] = static_cast<Json::LargestUInt>(m_hits.load());
+    info["misses"] = static_cast<Json::LargestUInt>(m_misses.load());
+    info["coalesced"] = static_cast<Json::LargestUInt>(m_coalesced.load());
+
+    return info;
+}
+
+void
+response_cache_t::lookup(const api::event_t& event, const std::string& blob, const std::shared_ptr<api::stream_t>& upstream) {
+    const cache_policy_t& policy = m_policies.find(event.name)->second;
+    const size_t key = hash(event.name, blob);
+
+    std::shared_ptr<entry_t> entry;
+
+    bool created = false;
+
+    while(!created) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            evict(event.name, policy.limit, now());
+
+            entry_map_t::iterator it = m_entries.find(key);
+
+            if(it == m_entries.end()) {
+                entry = std::make_shared<entry_t>(key, event.name, blob);
+                m_entries[key] = entry;
+
+                created = true;
+
+                continue;
+            }
+
+            if(it->second->event != event.name || it->second->blob != blob) {
+                // NOTE: The request is served by the engine, but not cached then.
+                entry.reset();
+                break;
+            }
+
+            entry = it->second;
+        }
+
+        // NOTE: The upstream is only written to with the entry lock held, so that the other cache
+        // entries are not blocked by slow clients.
+        std::unique_lock<std::mutex> entry_guard(entry->mutex);
+
+        if(entry->state == entry_t::states::pending) {
+            // Single flight: the request joins the ongoing invocation, replaying the part of the
+            // response which has been captured so far.
+            for(auto chunk = entry->chunks.begin(); chunk != entry->chunks.end(); ++chunk) {
+                upstream->write(chunk->data(), chunk->size());
+            }
+
+            entry->followers.push_back(upstream);
+
+            m_coalesced.fetch_add(1, std::memory_order_relaxed);
+
+            return;
+        }
+
+        if(entry->state == entry_t::states::ready && entry->expires > now()) {
+            entry_guard.unlock();
+
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+
+            // NOTE: Ready entries are never modified, so they can be replayed without locking.
+            for(auto chunk = entry->chunks.begin(); chunk != entry->chunks.end(); ++chunk) {
+                upstream->write(chunk->data(), chunk->size());
+            }
+
+            upstream->close();
+
+            return;
+        }
+
+        entry_guard.unlock();
+
+        // The entry is stale, so it's replaced with a fresh one.
+        discard(entry);
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+
+    api::stream_ptr_t downstream;
+
+    if(entry) {
+        downstream = dispatch(event, std::make_shared<capture_t>(
+            shared_from_this(),
+            entry,
+            policy.limit,
+            upstream
+        ));
+    } else {
+        downstream = dispatch(event, upstream);
+    }
+
+    if(downstream) {
+        downstream->write(blob.data(), blob.size());
+        downstream->close();
+    }
+}
+
+std::shared_ptr<cocaine::api::stream_t>
+response_cache_t::dispatch(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream) {
+    std::shared_ptr<api::stream_t> downstream;
+    std::string reason;
+
+    {
+        // NOTE: The backend lock only keeps the engine from being detached while the request is
+        // being submitted, the cache itself stays available meanwhile.
+        std::lock_guard<std::mutex> guard(m_backend_mutex);
+
+        if(!m_backend) {
+            reason = "the engine is not active";
+        } else try {
+            downstream = m_backend(event, upstream);
+        } catch(const cocaine::error_t& e) {
+            reason = e.what();
+        }
+    }
+
+    if(!downstream) {
+        upstream->error(resource_error, reason);
+        upstream->close();
+    }
+
+    return downstream;
+}
+
+void
+response_cache_t::complete(const std::shared_ptr<entry_t>& entry) {
+    std::vector<std::shared_ptr<api::stream_t>> followers;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::lock_guard<std::mutex> entry_guard(entry->mutex);
+
+        // NOTE: No more followers can join after this point, as the entry is either ready to be
+        // replayed or has been discarded.
+        followers.swap(entry->followers);
+
+        if(entry->state == entry_t::states::pending) {
+            const cache_policy_t& policy = m_policies.find(entry->event)->second;
+            const double timestamp = now();
+
+            entry->state = entry_t::states::ready;
+            entry->expires = timestamp + policy.ttl;
+
+            m_usage[entry->event] += entry->size;
+            m_order[entry->event].push_back(entry);
+
+            evict(entry->event, policy.limit, timestamp);
+        } else {
+            erase(entry);
+        }
+    }
+
+    for(auto it = followers.begin(); it != followers.end(); ++it) {
+        (*it)->close();
+    }
+}
+
+void
+response_cache_t::discard(const std::shared_ptr<entry_t>& entry) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    erase(entry);
+}
+
+void
+response_cache_t::evict(const std::string& event, uint64_t limit, double timestamp) {
+    std::deque<std::shared_ptr<entry_t>>& order = m_order[event];
+
+    // Evict the expired and then the oldest responses, until the event fits into its limit.
+    while(!order.empty() && (m_usage[event] > limit || order.front()->expires <= timestamp)) {
+        const std::shared_ptr<entry_t> entry = order.front();
+
+        erase(entry);
+    }
+}
+
+void
+response_cache_t::erase(const std::shared_ptr<entry_t>& entry) {
+    if(entry->state == entry_t::states::ready) {
+        std::deque<std::shared_ptr<entry_t>>& order = m_order[entry->event];
+
+        auto position = std::find(order.begin(), order.end(), entry);
+
+        if(position == order.end()) {
+            // The entry has been erased already.
+            return;
+        }
+
+        order.erase(position);
+
+        m_usage[entry->event] -= entry->size;
+    }
+
+    entry_map_t::iterator it = m_entries.find(entry->key);
+
+    if(it != m_entries.end() && it->second == entry) {
+        m_entries.erase(it);
+    }
+}
+
+size_t
+response_cache_t::hash(const std::string& event, const std::string& blob) {
+    std::hash<std::string> hasher;
+
+    // NOTE: Same combination as boost::hash_combine().
+    size_t seed = hasher(event);
+
+    seed ^= hasher(blob) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+
+    return seed;
+}
+
+double
+response_cache_t::now() {
+    using namespace std::chrono;
+
+#if defined(__clang__) || defined(HAVE_GCC47)
+    return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+#else
+    return duration_cast<duration<double>>(monotonic_clock::now().time_since_epoch()).count();
+#endif
+}
@@ -23,6 +23,7 @@
 #include "cocaine/api/logger.hpp"
 #include "cocaine/api/service.hpp"
 
+#include "cocaine/asio/buffer_pool.hpp"
 #include "cocaine/asio/reactor.hpp"
 #include "cocaine/asio/resolver.hpp"
 
@@ -46,17 +47,29 @@ using namespace cocaine;
 namespace fs = boost::filesystem;
 
 const bool defaults::log_output              = false;
+const bool defaults::deadline_first          = false;
+const bool defaults::sticky_routing          = false;
+const bool defaults::adaptive_concurrency    = false;
 const float defaults::heartbeat_timeout      = 30.0f;
 const float defaults::idle_timeout           = 600.0f;
 const float defaults::startup_timeout        = 10.0f;
 const float defaults::termination_timeout    = 5.0f;
 const unsigned long defaults::concurrency    = 10L;
 const unsigned long defaults::crashlog_limit = 50L;
+const unsigned long defaults::engine_threads = 1L;
+const unsigned long defaults::pool_minimum   = 0L;
+const float defaults::spawn_rate             = 0.0f;
 const unsigned long defaults::pool_limit     = 10L;
 const unsigned long defaults::queue_limit    = 100L;
 
 const float defaults::control_timeout        = 5.0f;
 const unsigned defaults::decoder_granularity = 256;
+const unsigned long defaults::buffer_size    = 4096L;
+const unsigned long defaults::buffer_limit   = 67108864L;
+const unsigned long defaults::buffer_reserve = 67108864L;
+const float defaults::buffer_timeout         = 30.0f;
+const unsigned long defaults::low_watermark  = 4194304L;
+const unsigned long defaults::high_watermark = 16777216L;
 
 const char defaults::plugins_path[]          = "/usr/lib/cocaine";
 const char defaults::runtime_path[]          = "/var/run/cocaine";
@@ -174,6 +187,61 @@ config_t::config_t(const std::string& config_path) {
         }
     }
 
+    // Buffer configuration
+
+    const Json::Value& buffers_config = root["buffers"];
+
+    buffers.initial_size = buffers_config.get(
+        "initial-size",
+        static_cast<Json::UInt>(defaults::buffer_size)
+    ).asUInt();
+
+    buffers.size_limit = buffers_config.get(
+        "size-limit",
+        static_cast<Json::UInt>(defaults::buffer_limit)
+    ).asUInt();
+
+    buffers.pool_limit = buffers_config.get(
+        "pool-limit",
+        static_cast<Json::UInt>(defaults::buffer_reserve)
+    ).asUInt();
+
+    buffers.idle_timeout = buffers_config.get(
+        "idle-timeout",
+        defaults::buffer_timeout
+    ).asDouble();
+
+    buffers.low_watermark = buffers_config.get(
+        "low-watermark",
+        static_cast<Json::UInt>(defaults::low_watermark)
+    ).asUInt();
+
+    buffers.high_watermark = buffers_config.get(
+        "high-watermark",
+        static_cast<Json::UInt>(defaults::high_watermark)
+    ).asUInt();
+
+    buffers.granularity = buffers_config.get(
+        "decoder-granularity",
+        static_cast<Json::UInt>(defaults::decoder_granularity)
+    ).asUInt();
+
+    if(buffers.initial_size < 4096) {
+        throw cocaine::error_t("the initial buffer size must be at least 4096 bytes");
+    }
+
+    if(buffers.size_limit < buffers.initial_size) {
+        throw cocaine::error_t("the buffer size limit must not be less than the initial buffer size");
+    }
+
+    if(buffers.low_watermark > buffers.high_watermark) {
+        throw cocaine::error_t("the low watermark must not be greater than the high watermark");
+    }
+
+    if(buffers.granularity == 0) {
+        throw cocaine::error_t("the decoder granularity must be positive");
+    }
+
     // Component configuration
 
     loggers  = parse(root["loggers"]);
@@ -282,6 +350,17 @@ void
 context_t::bootstrap() {
     auto blog = std::make_unique<logging::log_t>(*this, "bootstrap");
 
+    // NOTE: The buffer pool is shared by all the streams, so it has to be configured before
+    // any of them are created.
+    io::buffer_pool().configure({
+        config.buffers.initial_size,
+        config.buffers.size_limit,
+        config.buffers.pool_limit,
+        config.buffers.idle_timeout,
+        config.buffers.low_watermark,
+        config.buffers.high_watermark
+    });
+
     // Service locator internals.
     auto reactor = std::make_shared<io::reactor_t>();
     auto locator = std::make_unique<locator_t>(*this, *reactor);
@@ -29,9 +29,11 @@
 #include "cocaine/asio/socket.hpp"
 
 #include "cocaine/context.hpp"
+#include "cocaine/detail/cache.hpp"
 
 #include "cocaine/detail/manifest.hpp"
 #include "cocaine/detail/profile.hpp"
+#include "cocaine/detail/recycler.hpp"
 #include "cocaine/detail/session.hpp"
 #include "cocaine/detail/slave.hpp"
 #include "cocaine/detail/unique_id.hpp"
@@ -45,6 +47,8 @@
 #include "cocaine/traits/json.hpp"
 #include "cocaine/traits/literal.hpp"
 
+#include <cmath>
+
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics/median.hpp>
 #include <boost/accumulators/statistics/sum.hpp>
@@ -66,8 +70,68 @@ struct ignore {
     }
 };
 
+// Autoscaler tick interval, in seconds.
+const float scaling_interval = 1.0f;
+
+// Number of virtual nodes per slave on the sticky routing ring.
+const size_t ring_replicas = 64;
+
+// Smoothing factor for the autoscaler estimates.
+const double smoothing = 0.3;
+
+inline
+double
+ewma(double average, double sample) {
+    return average + smoothing * (sample - average);
 }
 
+struct live_slave {
+    template<class T>
+    bool
+    operator()(const T& slave) const {
+        // Draining slaves are on their way out, so they don't count.
+        return !slave.second->draining();
+    }
+};
+
+template<class T>
+struct deferred_release_action {
+    void
+    operator()() {
+        // NOTE: The object is destroyed in the reactor thread, along with this action.
+    }
+
+    std::shared_ptr<T> object;
+};
+
+}
+
+struct engine_t::shard_t {
+    shard_t(const std::shared_ptr<reactor_t>& reactor_, const std::string& endpoint_):
+        reactor(reactor_),
+        endpoint(endpoint_)
+    { }
+
+    // Event loop
+
+    const std::shared_ptr<reactor_t> reactor;
+    std::unique_ptr<std::thread> thread;
+
+    // Slave handshake endpoint
+
+    const std::string endpoint;
+    std::unique_ptr<io::connector<acceptor<local>>> connector;
+
+    // Channels pending the handshake
+
+    typedef std::map<
+        int,
+        std::shared_ptr<channel<io::socket<local>>>
+    > backlog_t;
+
+    backlog_t backlog;
+};
+
 engine_t::engine_t(context_t& context,
                    const std::shared_ptr<reactor_t>& reactor,
                    const manifest_t& manifest,
@@ -79,23 +143,72 @@ engine_t::engine_t(context_t& context,
     m_profile(profile),
     m_state(states::stopped),
     m_reactor(reactor),
+    m_spawner(std::make_shared<reactor_t>()),
     m_notification(m_reactor->native()),
     m_termination_timer(m_reactor->native()),
-    m_next_id(1)
+    m_deadline_timer(m_reactor->native()),
+    m_scaling_timer(m_reactor->native()),
+    m_next_id(1),
+    m_sessions(std::make_shared<detail::recycler_t>(profile.pool_limit * profile.concurrency)),
+    m_downstreams(std::make_shared<detail::recycler_t>(profile.pool_limit * profile.concurrency)),
+    m_queue(profile.deadline_first),
+    m_arrivals(0),
+    m_activations(0),
+    m_startup_time(0),
+    m_completions(0),
+    m_service_time(0)
 {
     m_notification.set<engine_t, &engine_t::on_notification>(this);
     m_notification.start();
 
-    const auto endpoint = local::endpoint(m_manifest.endpoint);
+    m_deadline_timer.set<engine_t, &engine_t::on_deadline>(this);
 
-    m_connector.reset(new connector<acceptor<local>>(
-        *m_reactor,
-        std::make_unique<acceptor<local>>(endpoint)
-    ));
+    if(!m_manifest.cache.empty()) {
+        m_cache = std::make_shared<response_cache_t>(
+            m_manifest.cache,
+            std::bind(&engine_t::submit, this, _1, _2)
+        );
+    }
 
-    m_connector->bind(
-        std::bind(&engine_t::on_connection, this, _1)
-    );
+    m_scaling = scaling_t {
+        m_reactor->native().now(),
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        std::max(1.0f, m_profile.spawn_rate),
+        m_profile.pool_minimum,
+        "none"
+    };
+
+    m_scaling_timer.set<engine_t, &engine_t::on_scaling>(this);
+    m_scaling_timer.start(scaling_interval, scaling_interval);
+
+    for(unsigned int i = 0; i < m_profile.engine_threads; ++i) {
+        std::unique_ptr<shard_t> shard;
+
+        if(m_profile.engine_threads == 1) {
+            shard.reset(new shard_t(m_reactor, m_manifest.endpoint));
+        } else {
+            shard.reset(new shard_t(
+                std::make_shared<reactor_t>(),
+                cocaine::format("%s.%d", m_manifest.endpoint, i)
+            ));
+        }
+
+        shard->connector.reset(new connector<acceptor<local>>(
+            *shard->reactor,
+            std::make_unique<acceptor<local>>(local::endpoint(shard->endpoint))
+        ));
+
+        shard->connector->bind(
+            std::bind(&engine_t::on_connection, this, std::ref(*shard), _1)
+        );
+
+        m_shards.push_back(std::move(shard));
+    }
 
     m_channel.reset(new channel<io::socket<local>>(
         *m_reactor,
@@ -119,13 +232,50 @@ engine_t::engine_t(context_t& context,
 
 engine_t::~engine_t() {
     BOOST_ASSERT(m_state == states::stopped);
-    boost::filesystem::remove(m_manifest.endpoint);
+
+    if(m_cache) {
+        // NOTE: Cached requests might outlive the engine, so they have to be disconnected from it.
+        m_cache->detach();
+    }
+
+    for(auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+        boost::filesystem::remove((*it)->endpoint);
+    }
 }
 
 void
 engine_t::run() {
     m_state = states::running;
+
+    m_spawner_thread.reset(new std::thread(std::bind(&reactor_t::run, m_spawner)));
+
+    for(auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+        if((*it)->reactor != m_reactor) {
+            (*it)->thread.reset(new std::thread(std::bind(&reactor_t::run, (*it)->reactor)));
+        }
+    }
+
     m_reactor->run();
+
+    // NOTE: Any spawn which is still in progress will be finished, but the resulting process will
+    // be terminated right away, as its slave is gone by now.
+    m_spawner->post(std::bind(&reactor_t::stop, m_spawner));
+
+    m_spawner_thread->join();
+    m_spawner_thread.reset();
+
+    for(auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+        if(!(*it)->thread) {
+            continue;
+        }
+
+        // NOTE: All the slave releases have been posted already, so they will be processed before
+        // the shard reactor stops.
+        (*it)->reactor->post(std::bind(&reactor_t::stop, (*it)->reactor));
+
+        (*it)->thread->join();
+        (*it)->thread.reset();
+    }
 }
 
 std::shared_ptr<api::stream_t>
@@ -134,27 +284,25 @@ engine_t::enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t
         throw cocaine::error_t("the engine is not active");
     }
 
-    auto session = std::make_shared<session_t>(
-        m_next_id++,
-        event,
-        upstream
-    );
-
-    {
-        std::lock_guard<session_queue_t> queue_guard(m_queue);
+    if(m_cache && m_cache->cacheable(event.name)) {
+        // NOTE: The cache passes the request back to the engine via submit() on a cache miss.
+        return m_cache->enqueue(event, upstream);
+    }
 
-        if(m_profile.queue_limit > 0 &&
-           m_queue.size() >= m_profile.queue_limit)
-        {
-            throw cocaine::error_t("the queue is full");
-        }
+    return submit(event, upstream);
+}
 
-        m_queue.push(session);
+std::shared_ptr<api::stream_t>
+engine_t::submit(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream) {
+    if(m_state != states::running) {
+        throw cocaine::error_t("the engine is not active");
     }
 
-    wake();
+    auto session = create(event, upstream);
 
-    return std::make_shared<session_t::downstream_t>(session);
+    queue(session);
+
+    return downstream(session);
 }
 
 std::shared_ptr<api::stream_t>
@@ -163,18 +311,42 @@ engine_t::enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t
         throw cocaine::error_t("the engine is not active");
     }
 
-    auto session = std::make_shared<session_t>(
-        m_next_id++,
-        event,
-        upstream
-    );
+    auto session = create(event, upstream);
 
-    pool_map_t::iterator it;
+    if(m_profile.sticky_routing) {
+        std::shared_ptr<slave_t> slave;
+
+        {
+            std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
+
+            if(slave_t* target = route(tag)) {
+                // NOTE: Keep the slave alive, as it might be erased while the session is being
+                // assigned outside of the pool lock.
+                slave = target->shared_from_this();
+            }
+        }
+
+        if(slave) {
+            m_arrivals.fetch_add(1, std::memory_order_relaxed);
+
+            slave->assign(session);
+
+            return downstream(session);
+        }
+
+        // The target slave is saturated or there are no active slaves yet, so the session will
+        // be assigned to the least loaded slave instead.
+        queue(session);
+
+        return downstream(session);
+    }
+
+    pool_map_t::mapped_type slave;
 
     {
         std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
 
-        it = m_pool.find(tag);
+        pool_map_t::iterator it = m_pool.find(tag);
 
         if(it == m_pool.end()) {
             if(m_pool.size() >= m_profile.pool_limit) {
@@ -183,21 +355,207 @@ engine_t::enqueue(const api::event_t& event, const std::shared_ptr<api::stream_t
 
             std::tie(it, std::ignore) = m_pool.insert(std::make_pair(
                 tag,
-                std::make_shared<slave_t>(m_context, *m_reactor, m_manifest, m_profile, tag, *this)
+                spawn(tag)
             ));
         }
+
+        // NOTE: Keep the slave alive, as it might be erased while the session is being assigned.
+        slave = it->second;
+    }
+
+    slave->assign(session);
+
+    return downstream(session);
+}
+
+std::vector<std::shared_ptr<api::stream_t>>
+engine_t::enqueue(const std::vector<std::pair<api::event_t, std::shared_ptr<api::stream_t>>>& batch) {
+    if(m_state != states::running) {
+        throw cocaine::error_t("the engine is not active");
+    }
+
+    std::vector<std::shared_ptr<api::stream_t>> downstreams;
+
+    downstreams.reserve(batch.size());
+
+    size_t queued = 0;
+
+    for(auto it = batch.begin(); it != batch.end(); ++it) {
+        if(m_cache && m_cache->cacheable(it->first.name)) {
+            downstreams.push_back(m_cache->enqueue(it->first, it->second));
+            continue;
+        }
+
+        if(m_profile.queue_limit > 0 &&
+           m_queue.size() >= m_profile.queue_limit)
+        {
+            downstreams.push_back(nullptr);
+            continue;
+        }
+
+        auto session = create(it->first, it->second);
+
+        m_queue.push(session);
+
+        downstreams.push_back(downstream(session));
+
+        ++queued;
+    }
+
+    if(queued) {
+        m_arrivals.fetch_add(queued, std::memory_order_relaxed);
+
+        // NOTE: The whole batch is picked up by a single pump.
+        wake();
+    }
+
+    return downstreams;
+}
+
+std::shared_ptr<session_t>
+engine_t::create(const api::event_t& event, const std::shared_ptr<api::stream_t>& upstream) {
+    return std::allocate_shared<session_t>(
+        detail::recycling_allocator<session_t>(m_sessions),
+        m_next_id++,
+        event,
+        upstream
+    );
+}
+
+void
+engine_t::queue(const std::shared_ptr<session_t>& session) {
+    if(m_profile.queue_limit > 0 &&
+       m_queue.size() >= m_profile.queue_limit)
+    {
+        throw cocaine::error_t("the queue is full");
     }
 
-    it->second->assign(session);
+    m_queue.push(session);
+    m_arrivals.fetch_add(1, std::memory_order_relaxed);
 
-    return std::make_shared<session_t::downstream_t>(session);
+    wake();
+}
+
+std::shared_ptr<api::stream_t>
+engine_t::downstream(const std::shared_ptr<session_t>& session) {
+    return std::allocate_shared<session_t::downstream_t>(
+        detail::recycling_allocator<session_t::downstream_t>(m_downstreams),
+        session
+    );
 }
 
 void
 engine_t::erase(const std::string& id, int code, const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
+
+        pool_map_t::iterator it = m_pool.find(id);
+
+        if(it != m_pool.end()) {
+            unindex(it->second.get());
+
+            // NOTE: This is called from the slave's own shard thread, so the slave is destroyed there.
+            m_pool.erase(it);
+        }
+    }
+
+    // The engine state is only managed from the engine thread.
+    m_reactor->post(std::bind(&engine_t::on_erase, this, code, reason));
+}
+
+void
+engine_t::reindex(slave_t& slave) {
+    std::lock_guard<std::mutex> index_guard(m_index_mutex);
+
+    auto it = m_index_keys.find(&slave);
+
+    if(it != m_index_keys.end()) {
+        m_index.erase(std::make_pair(it->second, &slave));
+    }
+
+    const size_t load = slave.load();
+
+    // NOTE: Terminated slaves never become active again, so they can't sneak back into the index
+    // after being erased from the pool.
+    if(slave.active() && load < slave.limit()) {
+        m_index.insert(std::make_pair(load, &slave));
+        m_index_keys[&slave] = load;
+    } else if(it != m_index_keys.end()) {
+        m_index_keys.erase(it);
+    }
+
+    if(!m_profile.sticky_routing) {
+        return;
+    }
+
+    const bool member = m_ring_members.count(&slave) != 0;
+
+    if(slave.active() && !member) {
+        std::hash<std::string> hash;
+
+        for(size_t i = 0; i < ring_replicas; ++i) {
+            m_ring[hash(cocaine::format("%s#%d", slave.id(), i))] = &slave;
+        }
+
+        m_ring_members.insert(&slave);
+    } else if(!slave.active() && member) {
+        unring(&slave);
+    }
+}
+
+void
+engine_t::unring(const slave_t* slave) {
+    std::hash<std::string> hash;
+
+    for(size_t i = 0; i < ring_replicas; ++i) {
+        ring_t::iterator it = m_ring.find(hash(cocaine::format("%s#%d", slave->id(), i)));
+
+        // NOTE: Virtual nodes of different slaves might collide, the latest one wins then.
+        if(it != m_ring.end() && it->second == slave) {
+            m_ring.erase(it);
+        }
+    }
+
+    m_ring_members.erase(slave);
+}
+
+void
+engine_t::record_startup(double duration) {
+    m_startup_time.fetch_add(duration * 1e6, std::memory_order_relaxed);
+    m_activations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+engine_t::record_service(double duration) {
+    m_service_time.fetch_add(duration * 1e6, std::memory_order_relaxed);
+    m_completions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool
+engine_t::surplus() {
     std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
+    return m_pool.size() > m_profile.pool_minimum;
+}
+
+void
+engine_t::unindex(const slave_t* slave) {
+    std::lock_guard<std::mutex> index_guard(m_index_mutex);
+
+    auto it = m_index_keys.find(slave);
+
+    if(it != m_index_keys.end()) {
+        m_index.erase(std::make_pair(it->second, const_cast<slave_t*>(slave)));
+        m_index_keys.erase(it);
+    }
 
-    m_pool.erase(id);
+    if(m_ring_members.count(slave)) {
+        unring(slave);
+    }
+}
+
+void
+engine_t::on_erase(int code, const std::string& reason) {
+    std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
 
     if(code == rpc::terminate::abnormal) {
         COCAINE_LOG_ERROR(m_log, "the app seems to be broken - %s", reason);
@@ -218,32 +576,34 @@ engine_t::wake() {
 }
 
 void
-engine_t::on_connection(const std::shared_ptr<io::socket<local>>& socket_) {
+engine_t::on_connection(shard_t& shard, const std::shared_ptr<io::socket<local>>& socket_) {
     const int fd = socket_->fd();
 
     COCAINE_LOG_DEBUG(m_log, "initiating a slave handshake on fd %d", fd);
 
-    auto channel_ = std::make_shared<channel<io::socket<local>>>(*m_reactor, socket_);
+    auto channel_ = std::make_shared<channel<io::socket<local>>>(*shard.reactor, socket_);
+
+    channel_->rd->granularity(m_profile.decoder_granularity);
 
     channel_->rd->bind(
-        std::bind(&engine_t::on_handshake,  this, fd, _1),
-        std::bind(&engine_t::on_disconnect, this, fd, _1)
+        std::bind(&engine_t::on_handshake,  this, std::ref(shard), fd, _1),
+        std::bind(&engine_t::on_disconnect, this, std::ref(shard), fd, _1)
     );
 
     channel_->wr->bind(
-        std::bind(&engine_t::on_disconnect, this, fd, _1)
+        std::bind(&engine_t::on_disconnect, this, std::ref(shard), fd, _1)
     );
 
-    m_backlog[fd] = channel_;
+    shard.backlog[fd] = channel_;
 }
 
 void
-engine_t::on_handshake(int fd, const message_t& message) {
+engine_t::on_handshake(shard_t& shard, int fd, const message_t& message) {
     std::string id;
-    backlog_t::mapped_type channel_ = m_backlog[fd];
+    shard_t::backlog_t::mapped_type channel_ = shard.backlog[fd];
 
     // Pop the channel.
-    m_backlog.erase(fd);
+    shard.backlog.erase(fd);
 
     try {
         message.as<rpc::handshake>(id);
@@ -271,7 +631,7 @@ engine_t::on_handshake(int fd, const message_t& message) {
 }
 
 void
-engine_t::on_disconnect(int fd, const std::error_code& ec) {
+engine_t::on_disconnect(shard_t& shard, int fd, const std::error_code& ec) {
     COCAINE_LOG_INFO(
         m_log,
         "slave has disconnected during the handshake on fd %d - [%d] %s",
@@ -280,7 +640,7 @@ engine_t::on_disconnect(int fd, const std::error_code& ec) {
         ec.message()
     );
 
-    m_backlog.erase(fd);
+    shard.backlog.erase(fd);
 }
 
 namespace {
@@ -353,6 +713,26 @@ engine_t::on_control(const message_t& message) {
         info["slaves"]["capacity"] = static_cast<Json::LargestUInt>(m_profile.pool_limit);
         info["slaves"]["idle"] = static_cast<Json::LargestUInt>(m_pool.size() - active);
         info["state"] = describe[static_cast<int>(m_state)];
+        info["threads"] = static_cast<Json::LargestUInt>(m_shards.size());
+
+        for(auto it = m_pool.cbegin(); it != m_pool.cend(); ++it) {
+            info["slaves"]["processed"][it->first] = static_cast<Json::LargestUInt>(it->second->processed());
+            info["slaves"]["concurrency"][it->first] = static_cast<Json::LargestUInt>(it->second->limit());
+        }
+
+        info["autoscaler"]["arrival-rate"] = m_scaling.arrival_rate;
+        info["autoscaler"]["arrival-trend"] = m_scaling.arrival_trend;
+        info["autoscaler"]["service-time"] = m_scaling.service_time;
+        info["autoscaler"]["startup-time"] = m_scaling.startup_time;
+        info["autoscaler"]["spawn-budget"] = m_scaling.spawn_budget;
+        info["autoscaler"]["target"] = static_cast<Json::LargestUInt>(m_scaling.target);
+        info["autoscaler"]["decision"] = m_scaling.decision;
+
+        info["isolate"] = m_isolate->info();
+
+        if(m_cache) {
+            info["cache"] = m_cache->info();
+        }
 
         m_channel->wr->write<control::info>(0UL, info);
     } break;
@@ -373,147 +753,347 @@ engine_t::on_control(const message_t& message) {
 
 void
 engine_t::on_notification(ev::async&, int) {
+    expire();
     pump();
     balance();
 }
 
 void
-engine_t::on_termination(ev::timer&, int) {
-    std::lock_guard<session_queue_t> queue_guard(m_queue);
+engine_t::on_deadline(ev::timer&, int) {
+    expire();
+    pump();
+}
+
+void
+engine_t::on_scaling(ev::timer&, int) {
+    if(m_state != states::running) {
+        return;
+    }
+
+    const ev::tstamp now = m_reactor->native().now();
+    const double elapsed = now - m_scaling.timestamp;
+
+    if(elapsed <= 0.0f) {
+        return;
+    }
+
+    m_scaling.timestamp = now;
+
+    const double arrival_rate = m_scaling.arrival_rate;
+
+    m_scaling.arrival_rate = ewma(arrival_rate, m_arrivals.exchange(0) / elapsed);
+    m_scaling.arrival_trend = ewma(m_scaling.arrival_trend, (m_scaling.arrival_rate - arrival_rate) / elapsed);
+
+    if(const uint64_t completions = m_completions.exchange(0)) {
+        const double sample = m_service_time.exchange(0) / 1e6 / completions;
+
+        // NOTE: The first sample is taken as is, so that the estimate doesn't start from zero.
+        m_scaling.service_time = m_scaling.service_time ? ewma(m_scaling.service_time, sample) : sample;
+
+        if(!m_scaling.measured) {
+            m_scaling.measured = now;
+        }
+    }
+
+    if(const uint64_t activations = m_activations.exchange(0)) {
+        const double sample = m_startup_time.exchange(0) / 1e6 / activations;
 
+        m_scaling.startup_time = m_scaling.startup_time ? ewma(m_scaling.startup_time, sample) : sample;
+    }
+
+    if(m_profile.spawn_rate) {
+        m_scaling.spawn_budget = std::min<double>(
+            std::max(1.0f, m_profile.spawn_rate),
+            m_scaling.spawn_budget + elapsed * m_profile.spawn_rate
+        );
+    }
+
+    balance();
+    shrink();
+}
+
+void
+engine_t::on_termination(ev::timer&, int) {
     COCAINE_LOG_WARNING(m_log, "forcing the engine termination");
 
     stop();
 }
 
-namespace {
-
-struct load {
-    template<class T>
-    bool
-    operator()(const T& lhs, const T& rhs) const {
-        return lhs.second->load() < rhs.second->load();
-    }
-};
+slave_t*
+engine_t::route(const std::string& tag) {
+    std::lock_guard<std::mutex> index_guard(m_index_mutex);
 
-struct available {
-    template<class T>
-    bool
-    operator()(const T& slave) const {
-        return slave.second->active() && slave.second->load() < max;
+    if(m_ring.empty()) {
+        return nullptr;
     }
 
-    const size_t max;
-};
+    ring_t::const_iterator it = m_ring.lower_bound(std::hash<std::string>()(tag));
 
-template<class It, class Compare, class Predicate>
-inline
-It
-min_element_if(It first, It last, Compare compare, Predicate predicate) {
-    while(first != last && !predicate(*first)) {
-        ++first;
+    if(it == m_ring.end()) {
+        it = m_ring.begin();
     }
 
-    if(first == last) {
-        return last;
+    if(!it->second->active() || it->second->load() >= it->second->limit()) {
+        return nullptr;
     }
 
-    It result = first;
+    return it->second;
+}
+
+slave_t*
+engine_t::select() {
+    std::lock_guard<std::mutex> index_guard(m_index_mutex);
+
+    while(!m_index.empty()) {
+        const load_index_t::value_type entry = *m_index.begin();
+        const size_t load = entry.second->load();
+
+        m_index.erase(m_index.begin());
 
-    while(++first != last) {
-        if(predicate(*first) && compare(*first, *result)) {
-            result = first;
+        if(!entry.second->active() || load >= entry.second->limit()) {
+            m_index_keys.erase(entry.second);
+            continue;
         }
-    }
 
-    return result;
-}
+        // NOTE: Slaves report their load changes asynchronously, so the entry might be stale, in
+        // which case it's fixed up here and the index is consulted once again.
+        m_index.insert(std::make_pair(load, entry.second));
+        m_index_keys[entry.second] = load;
 
+        if(load == entry.first) {
+            return entry.second;
+        }
+    }
+
+    return nullptr;
 }
 
 void
 engine_t::pump() {
+    std::deque<session_queue_t::value_type> batch;
     session_queue_t::value_type session;
 
-    while(!m_queue.empty()) {
-        std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
+    std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
 
-        const auto it = min_element_if(m_pool.begin(), m_pool.end(), load(), available {
-            m_profile.concurrency
-        });
+    while(!m_queue.empty()) {
+        // Move out as many sessions as the pool could possibly accept at once.
+        while(batch.size() < m_pool.size() * m_profile.concurrency && m_queue.pop(session)) {
+            batch.push_back(std::move(session));
+        }
 
-        if(it == m_pool.end()) {
+        if(batch.empty()) {
             return;
         }
 
-        {
-            std::lock_guard<session_queue_t> queue_guard(m_queue);
+        while(!batch.empty()) {
+            slave_t* slave = select();
 
-            if(m_queue.empty()) {
-                return;
+            if(!slave) {
+                break;
             }
 
-            // Move out a new session from the queue.
-            session = std::move(m_queue.front());
+            // NOTE: The slave will update its position in the load index by itself.
+            slave->assign(batch.front());
 
-            // Destroy an empty session husk.
-            m_queue.pop_front();
+            batch.pop_front();
         }
 
-        // Process the queue head outside the lock, because it might take some considerable amount
-        // of time if the session has expired and there's some heavy-lifting in the error handler.
-        it->second->assign(session);
+        if(!batch.empty()) {
+            // Return the sessions which weren't assigned to their original queue positions.
+            std::for_each(batch.begin(), batch.end(), std::bind(
+                &session_queue_t::requeue,
+                std::ref(m_queue),
+                _1
+            ));
+
+            return;
+        }
+    }
+}
+
+void
+engine_t::expire() {
+    std::vector<session_queue_t::value_type> expired;
+
+    const ev::tstamp now = m_reactor->native().now();
+
+    m_queue.expire(now, expired);
+
+    if(!expired.empty()) {
+        COCAINE_LOG_DEBUG(
+            m_log,
+            "dropping %llu expired %s",
+            expired.size(),
+            expired.size() == 1 ? "session" : "sessions"
+        );
+    }
+
+    for(auto it = expired.begin(); it != expired.end(); ++it) {
+        (*it)->upstream->error(deadline_error, "the session has expired in the queue");
+    }
+
+    m_deadline_timer.stop();
+
+    if(const double deadline = m_queue.deadline()) {
+        m_deadline_timer.start(std::max(deadline - now, 0.0));
     }
 }
 
+size_t
+engine_t::estimate() {
+    // Extrapolate the arrival rate to the moment when a slave spawned right now would be ready.
+    // NOTE: The trend is only used to grow ahead of the demand, a falling trend never lowers the
+    // estimate below the current arrival rate.
+    const double arrival_rate = std::max(
+        m_scaling.arrival_rate,
+        m_scaling.arrival_rate + m_scaling.arrival_trend * m_scaling.startup_time
+    );
+
+    // The expected number of sessions in flight, as per the Little's law.
+    const double demand = arrival_rate * m_scaling.service_time;
+
+    size_t target = std::ceil(demand / m_profile.concurrency);
+
+    if(!m_queue.empty()) {
+        // Fall back to the queue depth when there are no service time measurements yet.
+        target = std::max(target, std::max(1UL, m_queue.size() / m_profile.grow_threshold));
+    }
+
+    return std::min(m_profile.pool_limit, std::max(m_profile.pool_minimum, target));
+}
+
 void
 engine_t::balance() {
     std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
 
-    if(m_pool.size() >= m_profile.pool_limit ||
-       m_pool.size() * m_profile.grow_threshold >= m_queue.size())
-    {
+    m_scaling.target = estimate();
+
+    const size_t live = std::count_if(m_pool.begin(), m_pool.end(), live_slave());
+
+    if(m_scaling.target <= live || m_pool.size() >= m_profile.pool_limit) {
+        m_scaling.decision = "hold";
         return;
     }
 
-    const unsigned int target = std::min(
-        m_profile.pool_limit,
-        std::max(
-            1UL,
-            m_queue.size() / m_profile.grow_threshold
-        )
-    );
+    size_t count = std::min(m_scaling.target - live, m_profile.pool_limit - m_pool.size());
 
-    if(target <= m_pool.size()) {
+    if(m_profile.spawn_rate) {
+        count = std::min<size_t>(count, m_scaling.spawn_budget);
+    }
+
+    if(count == 0) {
+        m_scaling.decision = "throttle";
         return;
     }
 
+    m_scaling.decision = "grow";
+
     COCAINE_LOG_INFO(
         m_log,
         "enlarging the pool from %d to %d slaves",
         m_pool.size(),
-        target
+        m_pool.size() + count
     );
 
-    while(m_pool.size() != target) {
+    while(count--) {
         const auto id = unique_id_t().string();
 
         try {
             m_pool.insert(std::make_pair(
                 id,
-                std::make_shared<slave_t>(m_context, *m_reactor, m_manifest, m_profile, id, *this)
+                spawn(id)
             ));
         } catch(const std::system_error& e) {
             COCAINE_LOG_ERROR(m_log, "unable to spawn more slaves - %s", e.what());
             break;
         }
+
+        if(m_profile.spawn_rate) {
+            m_scaling.spawn_budget -= 1.0f;
+        }
     }
 }
 
 void
-engine_t::migrate(states target) {
-    std::lock_guard<session_queue_t> queue_guard(m_queue);
+engine_t::shrink() {
+    std::lock_guard<std::mutex> pool_guard(m_pool_mutex);
+
+    // NOTE: Without the service time, or with a single partial interval of it, the estimate is too
+    // low, so the pool must not shrink on it or it would drain the busy slaves right after start.
+    if(!m_scaling.measured || m_scaling.timestamp - m_scaling.measured < scaling_interval) {
+        return;
+    }
+
+    const size_t live = std::count_if(m_pool.begin(), m_pool.end(), live_slave());
+
+    if(m_scaling.target >= live || !m_queue.empty()) {
+        m_scaling.surplus = 0.0f;
+        return;
+    }
+
+    if(!m_scaling.surplus) {
+        m_scaling.surplus = m_scaling.timestamp;
+    }
+
+    // NOTE: The pool only shrinks once the surplus has lasted for the whole idle timeout, so that
+    // short lulls don't drain the slaves which would be needed again right after. Without the idle
+    // timeout, the slaves are kept forever, as they are when idle.
+    if(!m_profile.idle_timeout || m_scaling.timestamp - m_scaling.surplus < m_profile.idle_timeout) {
+        return;
+    }
 
+    // Drain a single least loaded slave per tick, so that the pool shrinks gradually.
+    slave_t* slave = select();
+
+    if(!slave) {
+        return;
+    }
+
+    m_scaling.decision = "shrink";
+
+    COCAINE_LOG_INFO(m_log, "shrinking the pool from %d to %d slaves", live, live - 1);
+
+    unindex(slave);
+
+    slave->drain();
+}
+
+std::shared_ptr<slave_t>
+engine_t::spawn(const std::string& id) {
+    std::vector<size_t> population(m_shards.size(), 0);
+
+    // Place the new slave into the least populated shard.
+    for(auto it = m_pool.begin(); it != m_pool.end(); ++it) {
+        for(size_t i = 0; i < m_shards.size(); ++i) {
+            if(&it->second->reactor() == m_shards[i]->reactor.get()) {
+                ++population[i];
+                break;
+            }
+        }
+    }
+
+    const shard_t& shard = *m_shards[
+        std::min_element(population.begin(), population.end()) - population.begin()
+    ];
+
+    auto slave = std::make_shared<slave_t>(
+        m_context,
+        *shard.reactor,
+        m_manifest,
+        m_profile,
+        id,
+        *this
+    );
+
+    // NOTE: This doesn't block, the slave's watchers are set up in the shard thread and then the
+    // process is spawned in the spawner thread.
+    slave->launch(shard.endpoint, *m_spawner);
+
+    return slave;
+}
+
+void
+engine_t::migrate(states target) {
     m_state = target;
 
     if(!m_queue.empty()) {
@@ -524,15 +1104,7 @@ engine_t::migrate(states target) {
             m_queue.size() == 1 ? "session" : "sessions"
         );
 
-        // Abort all the outstanding sessions.
-        while(!m_queue.empty()) {
-            m_queue.front()->upstream->error(
-                resource_error,
-                "engine is shutting down"
-            );
-
-            m_queue.pop_front();
-        }
+        abort();
     }
 
     unsigned int pending = 0;
@@ -565,13 +1137,51 @@ engine_t::migrate(states target) {
     m_termination_timer.start(m_profile.termination_timeout);
 }
 
+void
+engine_t::abort() {
+    session_queue_t::value_type session;
+
+    // Abort all the outstanding sessions.
+    while(m_queue.pop(session)) {
+        session->upstream->error(
+            resource_error,
+            "engine is shutting down"
+        );
+    }
+}
+
 void
 engine_t::stop() {
     m_termination_timer.stop();
+    m_deadline_timer.stop();
+    m_scaling_timer.stop();
+
+    for(auto it = m_pool.begin(); it != m_pool.end(); ++it) {
+        reactor_t& reactor = it->second->reactor();
+
+        if(&reactor != m_reactor.get()) {
+            // Slaves living in other shards have to be destroyed in their own threads.
+            reactor.post(deferred_release_action<slave_t> { std::move(it->second) });
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> index_guard(m_index_mutex);
+
+        m_index.clear();
+        m_index_keys.clear();
+
+        m_ring.clear();
+        m_ring_members.clear();
+    }
 
     // NOTE: This will force the slave pool termination.
     m_pool.clear();
 
+    // NOTE: Sessions might have been pushed by the clients which had observed the engine running
+    // right before the state migration.
+    abort();
+
     if(m_state == states::stopping) {
         m_state = states::stopped;
 
@@ -20,7 +20,9 @@
 
 #include "cocaine/detail/drivers/fs.hpp"
 #include "cocaine/detail/drivers/time.hpp"
+#include "cocaine/detail/isolates/cgroups.hpp"
 #include "cocaine/detail/isolates/process.hpp"
+#include "cocaine/detail/isolates/zygote.hpp"
 #include "cocaine/detail/gateways/adhoc.hpp"
 #include "cocaine/detail/loggers/files.hpp"
 #include "cocaine/detail/loggers/syslog.hpp"
@@ -35,7 +37,9 @@ void
 cocaine::essentials::initialize(api::repository_t& repository) {
     repository.insert<driver::fs_t>("fs");
     repository.insert<driver::recurring_timer_t>("time");
+    repository.insert<isolate::cgroups_t>("cgroups");
     repository.insert<isolate::process_t>("process");
+    repository.insert<isolate::zygote_t>("zygote");
     repository.insert<gateway::adhoc_t>("adhoc");
     repository.insert<logger::files_t>("files");
     repository.insert<logger::syslog_t>("syslog");
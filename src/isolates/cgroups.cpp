@@ -0,0 +1,195 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/detail/isolates/cgroups.hpp"
+
+#include "cocaine/context.hpp"
+#include "cocaine/logging.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace cocaine;
+using namespace cocaine::isolate;
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+// Converts a limit, given either as a number or as a string like "max", to the cgroup format.
+std::string
+limit(const Json::Value& value) {
+    if(value.isString()) {
+        return value.asString();
+    }
+
+    return boost::lexical_cast<std::string>(value.asUInt64());
+}
+
+// Parses flat keyed cgroup files, like cpu.stat or memory.events.
+Json::Value
+parse(const std::string& content) {
+    Json::Value result(Json::objectValue);
+
+    std::istringstream stream(content);
+    std::string key;
+    Json::UInt64 value;
+
+    while(stream >> key >> value) {
+        result[key] = value;
+    }
+
+    return result;
+}
+
+}
+
+cgroups_t::cgroups_t(context_t& context, const std::string& name, const Json::Value& args):
+    category_type(context, name, args),
+    m_log(new logging::log_t(context, name)),
+    m_process(context, name, args)
+{
+    const fs::path root = args.get("root", "/sys/fs/cgroup/cocaine").asString();
+
+    m_path = (root / name).string();
+
+    try {
+        fs::create_directories(m_path);
+    } catch(const fs::filesystem_error& e) {
+        throw cocaine::error_t("unable to create the cgroup '%s' - %s", m_path, e.what());
+    }
+
+    // NOTE: The controllers might have been enabled already, or the subtree might have been
+    // delegated with them enabled, so it's not an error if this fails.
+    try {
+        write((root / "cgroup.subtree_control").string(), "+cpu +memory");
+    } catch(const cocaine::error_t& e) {
+        COCAINE_LOG_WARNING(m_log, "unable to enable the cgroup controllers - %s", e.what());
+    }
+
+    // Resource limits
+
+    if(args.isMember("cpu-weight")) {
+        write(m_path + "/cpu.weight", limit(args["cpu-weight"]));
+    }
+
+    if(args.isMember("cpu-max")) {
+        const Json::Value& value = args["cpu-max"];
+
+        if(value.isString()) {
+            write(m_path + "/cpu.max", value.asString());
+        } else {
+            // The limit is a number of CPUs, which is converted to a quota per the default period.
+            const unsigned long period = 100000;
+
+            write(m_path + "/cpu.max", cocaine::format(
+                "%d %d",
+                static_cast<unsigned long>(value.asDouble() * period),
+                period
+            ));
+        }
+    }
+
+    if(args.isMember("memory-max")) {
+        write(m_path + "/memory.max", limit(args["memory-max"]));
+    }
+}
+
+cgroups_t::~cgroups_t() {
+    if(::rmdir(m_path.c_str()) != 0) {
+        COCAINE_LOG_WARNING(m_log, "unable to remove the cgroup '%s' - %s", m_path, std::strerror(errno));
+    }
+}
+
+std::unique_ptr<api::handle_t>
+cgroups_t::spawn(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe) {
+    // NOTE: The slave is placed into the cgroup before it executes the app, so that nothing it does
+    // escapes the limits. See process_t::start() for the details.
+    const int cgroup = ::open(m_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if(cgroup < 0) {
+        throw cocaine::error_t("unable to open '%s' - %s", m_path, std::strerror(errno));
+    }
+
+    pid_t pid;
+
+    try {
+        pid = m_process.start(path, args, environment, pipe, cgroup);
+    } catch(...) {
+        ::close(cgroup);
+        throw;
+    }
+
+    ::close(cgroup);
+
+    return process_t::attach(pid);
+}
+
+Json::Value
+cgroups_t::info() const {
+    Json::Value info(Json::objectValue);
+
+    try {
+        info["cpu"] = parse(read(m_path + "/cpu.stat"));
+        info["memory"]["current"] = static_cast<Json::UInt64>(
+            boost::lexical_cast<unsigned long long>(read(m_path + "/memory.current"))
+        );
+        info["memory"]["events"] = parse(read(m_path + "/memory.events"));
+        info["memory"]["limit"] = read(m_path + "/memory.max");
+    } catch(const std::exception& e) {
+        info["error"] = e.what();
+    }
+
+    return info;
+}
+
+void
+cgroups_t::write(const std::string& file, const std::string& value) const {
+    std::ofstream stream(file.c_str());
+
+    // NOTE: Kernel reports invalid values on flush, so it's done explicitly.
+    if(!(stream << value << std::flush)) {
+        throw cocaine::error_t("unable to write '%s' to '%s'", value, file);
+    }
+}
+
+std::string
+cgroups_t::read(const std::string& file) const {
+    std::ifstream stream(file.c_str());
+    std::string content;
+
+    if(!stream || !std::getline(stream, content, '\0')) {
+        throw cocaine::error_t("unable to read '%s'", file);
+    }
+
+    // Strip the trailing newline.
+    return content.substr(0, content.find_last_not_of('\n') + 1);
+}
@@ -33,10 +33,23 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <fcntl.h>
+#include <spawn.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+// NOTE: Changing the working directory with a spawn file action is a fairly recent extension.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+    #define HAVE_POSIX_SPAWN_CHDIR
+#endif
+
+// NOTE: Spawning right into a cgroup is supported since glibc 2.41, which does it with clone3() and
+// CLONE_INTO_CGROUP. Without it, slaves are forked to move themselves into their cgroups.
+#if defined(POSIX_SPAWN_SETCGROUP)
+    #define HAVE_POSIX_SPAWN_CGROUP
+#endif
+
 using namespace cocaine;
 using namespace cocaine::isolate;
 
@@ -80,7 +93,23 @@ process_t::process_t(context_t& context, const std::string& name, const Json::Va
 #else
     m_working_directory((fs::path(context.config.path.spool) / name).string())
 #endif
-{ }
+{
+    const std::string method = args.get("spawn-method", "posix_spawn").asString();
+
+    if(method != "posix_spawn" && method != "fork") {
+        throw cocaine::error_t("unknown spawn method '%s'", method);
+    }
+
+#if defined(HAVE_POSIX_SPAWN_CHDIR)
+    m_posix_spawn = method == "posix_spawn";
+#else
+    if(method == "posix_spawn") {
+        COCAINE_LOG_WARNING(m_log, "posix_spawn() is not fully supported on this platform, falling back to fork()");
+    }
+
+    m_posix_spawn = false;
+#endif
+}
 
 process_t::~process_t() {
     // Empty.
@@ -95,6 +124,149 @@ process_t::~process_t() {
 
 std::unique_ptr<api::handle_t>
 process_t::spawn(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe) {
+    return attach(start(path, args, environment, pipe));
+}
+
+pid_t
+process_t::start(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe,
+                 int cgroup)
+{
+#if defined(HAVE_POSIX_SPAWN_CGROUP)
+    const bool spawnable = m_posix_spawn;
+#else
+    // NOTE: This gives up the posix_spawn() gains for the cgroup-isolated apps, as the whole parent
+    // address space is copied on every fork.
+    const bool spawnable = m_posix_spawn && cgroup < 0;
+#endif
+
+    if(spawnable) {
+        return launch(path, args, environment, pipe, cgroup);
+    } else {
+        return fork(path, args, environment, pipe, cgroup);
+    }
+}
+
+std::unique_ptr<api::handle_t>
+process_t::attach(pid_t pid) {
+    return std::make_unique<process_handle_t>(pid);
+}
+
+pid_t
+process_t::launch(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe,
+                  int cgroup)
+{
+    // Prepare the command line, pointing right into the arguments, as they outlive the spawn.
+
+    std::vector<char*> argv = { const_cast<char*>(path.c_str()) };
+
+    for(auto it = args.begin(); it != args.end(); ++it) {
+        argv.push_back(const_cast<char*>(it->first.c_str()));
+        argv.push_back(const_cast<char*>(it->second.c_str()));
+    }
+
+    argv.push_back(nullptr);
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // NOTE: The daemon environment might be changed with setenv() or putenv() at any time, which
+    // replaces the entries in 'environ', so the entries are compared by address on every spawn.
+
+    size_t unchanged = 0;
+
+    while(environ[unchanged] != nullptr &&
+          unchanged < m_environ.size() &&
+          environ[unchanged] == m_environ[unchanged])
+    {
+        ++unchanged;
+    }
+
+    const bool stale = environ[unchanged] != nullptr || unchanged != m_environ.size();
+
+    if(m_envp.empty() || stale || m_environment != environment) {
+        m_environment = environment;
+        m_environ.clear();
+        m_envp_storage.clear();
+
+        for(char** ptr = environ; *ptr != nullptr; ++ptr) {
+            m_environ.push_back(*ptr);
+            m_envp_storage.push_back(*ptr);
+        }
+
+        boost::format format("%s=%s");
+
+        for(auto it = environment.begin(); it != environment.end(); ++it, format.clear()) {
+            m_envp_storage.push_back((format % it->first % it->second).str());
+        }
+
+        m_envp.clear();
+
+        for(auto it = m_envp_storage.begin(); it != m_envp_storage.end(); ++it) {
+            m_envp.push_back(const_cast<char*>(it->c_str()));
+        }
+
+        m_envp.push_back(nullptr);
+    }
+
+    // Redirect the output and set the correct working directory
+
+    posix_spawn_file_actions_t actions;
+
+    ::posix_spawn_file_actions_init(&actions);
+    ::posix_spawn_file_actions_adddup2(&actions, pipe, STDOUT_FILENO);
+    ::posix_spawn_file_actions_adddup2(&actions, pipe, STDERR_FILENO);
+#if defined(HAVE_POSIX_SPAWN_CHDIR)
+    ::posix_spawn_file_actions_addchdir_np(&actions, m_working_directory.c_str());
+#endif
+
+    // Unblock all the signals
+
+    posix_spawnattr_t attributes;
+
+    sigset_t signals;
+
+    sigemptyset(&signals);
+
+    short flags = POSIX_SPAWN_SETSIGMASK;
+
+    ::posix_spawnattr_init(&attributes);
+    ::posix_spawnattr_setsigmask(&attributes, &signals);
+
+    // Place the slave into the cgroup right away, so that nothing it does escapes the limits
+
+    if(cgroup >= 0) {
+#if defined(HAVE_POSIX_SPAWN_CGROUP)
+        ::posix_spawnattr_setcgroup_np(&attributes, cgroup);
+        flags |= POSIX_SPAWN_SETCGROUP;
+#else
+        ::posix_spawnattr_destroy(&attributes);
+        ::posix_spawn_file_actions_destroy(&actions);
+
+        throw cocaine::error_t("spawning into a cgroup is not supported on this platform");
+#endif
+    }
+
+    ::posix_spawnattr_setflags(&attributes, flags);
+
+    // Spawn the slave
+
+    pid_t pid = 0;
+
+    const int rv = ::posix_spawn(&pid, argv[0], &actions, &attributes, argv.data(), m_envp.data());
+
+    ::posix_spawnattr_destroy(&attributes);
+    ::posix_spawn_file_actions_destroy(&actions);
+
+    if(rv != 0) {
+        throw std::system_error(rv, std::system_category(), cocaine::format("unable to execute '%s'", path));
+    }
+
+    return pid;
+}
+
+pid_t
+process_t::fork(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe,
+                int cgroup)
+{
     const pid_t pid = ::fork();
 
     if(pid < 0) {
@@ -102,12 +274,27 @@ process_t::spawn(const std::string& path, const api::string_map_t& args, const a
     }
 
     if(pid > 0) {
-        return std::make_unique<process_handle_t>(pid);
+        return pid;
     }
 
     ::dup2(pipe, STDOUT_FILENO);
     ::dup2(pipe, STDERR_FILENO);
 
+    // Move into the cgroup before anything else is allocated, so that nothing escapes its limits.
+    // Writing zero moves the writing process itself.
+
+    if(cgroup >= 0) {
+        const int procs = ::openat(cgroup, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+
+        if(procs < 0 || ::write(procs, "0", 1) != 1) {
+            std::error_code ec(errno, std::system_category());
+            std::cerr << cocaine::format("unable to move into the cgroup - [%d] %s", ec.value(), ec.message());
+            std::_Exit(EXIT_FAILURE);
+        }
+
+        ::close(procs);
+    }
+
     // Set the correct working directory
 
     try {
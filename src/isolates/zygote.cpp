@@ -0,0 +1,425 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/detail/isolates/zygote.hpp"
+
+#include "cocaine/context.hpp"
+#include "cocaine/logging.hpp"
+#include "cocaine/memory.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace cocaine;
+using namespace cocaine::isolate;
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+struct zygote_handle_t:
+    public api::handle_t
+{
+    zygote_handle_t(const std::shared_ptr<zygote_t>& zygote, pid_t pid, uint64_t generation):
+        m_zygote(zygote),
+        m_pid(pid),
+        m_generation(generation),
+        m_terminated(false)
+    { }
+
+    virtual
+   ~zygote_handle_t() {
+        terminate();
+    }
+
+    virtual
+    void
+    terminate() {
+        if(m_terminated) {
+            return;
+        }
+
+        m_terminated = true;
+
+        // NOTE: The slave is a child of the template process, which reaps it, so the pid might be
+        // reused by the time it's terminated. Only the template knows whether it's still its child.
+        m_zygote->terminate(m_pid, m_generation);
+    }
+
+private:
+    const std::shared_ptr<zygote_t> m_zygote;
+
+    const pid_t m_pid;
+    const uint64_t m_generation;
+
+    bool m_terminated;
+};
+
+}
+
+zygote_t::zygote_t(context_t& context, const std::string& name, const Json::Value& args):
+    category_type(context, name, args),
+    m_log(new logging::log_t(context, name)),
+#if BOOST_VERSION >= 104600
+    m_working_directory((fs::path(context.config.path.spool) / name).native()),
+#else
+    m_working_directory((fs::path(context.config.path.spool) / name).string()),
+#endif
+    m_timeout(args.get("startup-timeout", defaults::startup_timeout).asDouble()),
+    m_pid(0),
+    m_socket(-1),
+    m_output(-1),
+    m_generation(0)
+{ }
+
+zygote_t::~zygote_t() {
+    stop();
+}
+
+std::unique_ptr<api::handle_t>
+zygote_t::spawn(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment, int pipe) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // NOTE: The template is shared by all the slaves, so it doesn't get any of the slave specific
+    // arguments, like the slave ID or the endpoint.
+    api::string_map_t common;
+
+    const char* keys[] = { "--app", "--locator" };
+
+    for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        api::string_map_t::const_iterator it = args.find(keys[i]);
+
+        if(it != args.end()) {
+            common.insert(*it);
+        }
+    }
+
+    if(m_pid == 0) {
+        start(path, common, environment);
+    }
+
+    pid_t pid;
+
+    try {
+        pid = fork(args, pipe);
+    } catch(const std::system_error& e) {
+        COCAINE_LOG_WARNING(m_log, "the zygote has failed - %s, restarting", e.what());
+
+        // NOTE: The template might have crashed or hung, so give it another chance, once.
+        stop();
+        start(path, common, environment);
+
+        try {
+            pid = fork(args, pipe);
+        } catch(...) {
+            drain();
+            throw;
+        }
+    } catch(...) {
+        drain();
+        throw;
+    }
+
+    drain();
+
+    return std::make_unique<zygote_handle_t>(shared_from_this(), pid, m_generation);
+}
+
+void
+zygote_t::terminate(pid_t pid, uint64_t generation) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if(m_socket < 0 || generation != m_generation) {
+        // NOTE: The template which has forked this slave has been killed, so the slave has been
+        // reparented and nobody else is going to terminate it.
+        ::kill(pid, SIGKILL);
+        return;
+    }
+
+    drain();
+
+    std::string request("--terminate");
+
+    request.push_back('\0');
+    request.append(boost::lexical_cast<std::string>(pid));
+    request.push_back('\0');
+
+    // NOTE: Termination requests are not replied to. If the template is gone, it will be noticed
+    // and restarted on the next fork request.
+    ::send(m_socket, request.data(), request.size(), MSG_NOSIGNAL);
+}
+
+#ifdef __APPLE__
+    #include <crt_externs.h>
+    #define environ (*_NSGetEnviron())
+#else
+    extern char** environ;
+#endif
+
+void
+zygote_t::start(const std::string& path, const api::string_map_t& args, const api::string_map_t& environment) {
+    int sockets[2],
+        output[2];
+
+#if defined(SOCK_CLOEXEC)
+    // NOTE: Both ends are created close-on-exec atomically, so that slaves spawned concurrently by
+    // some other isolate don't inherit them. The template's end is made inheritable after forking.
+    if(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
+        throw std::system_error(errno, std::system_category(), "unable to create a zygote socket");
+    }
+#else
+    if(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) != 0) {
+        throw std::system_error(errno, std::system_category(), "unable to create a zygote socket");
+    }
+
+    ::fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    // Template output capture
+
+    if(::pipe(output) != 0) {
+        ::close(sockets[0]);
+        ::close(sockets[1]);
+
+        throw std::system_error(errno, std::system_category(), "unable to create an output pipe");
+    }
+
+    for(size_t i = 0; i < 2; ++i) {
+        ::fcntl(output[i], F_SETFD, FD_CLOEXEC);
+
+        // NOTE: The output is only drained when the isolate is used, so a chatty template loses
+        // its output once the pipe is full instead of blocking on it.
+        ::fcntl(output[i], F_SETFL, O_NONBLOCK);
+    }
+
+    const pid_t pid = ::fork();
+
+    if(pid < 0) {
+        ::close(sockets[0]);
+        ::close(sockets[1]);
+        ::close(output[0]);
+        ::close(output[1]);
+
+        throw std::system_error(errno, std::system_category(), "unable to fork");
+    }
+
+    if(pid > 0) {
+        ::close(sockets[1]);
+        ::close(output[1]);
+
+        COCAINE_LOG_INFO(m_log, "started the zygote for '%s', pid: %d", path, pid);
+
+        m_pid = pid;
+        m_socket = sockets[0];
+        m_output = output[0];
+
+        ++m_generation;
+
+        struct timeval timeout = {
+            static_cast<time_t>(m_timeout),
+            static_cast<suseconds_t>((m_timeout - static_cast<time_t>(m_timeout)) * 1e6)
+        };
+
+        // The template replies only after it has loaded the app code.
+        ::setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        return;
+    }
+
+    ::fcntl(sockets[1], F_SETFD, 0);
+
+    // The template output goes to the isolate log, while each slave has its own output pipe.
+    ::dup2(output[1], STDOUT_FILENO);
+    ::dup2(output[1], STDERR_FILENO);
+
+    // Set the correct working directory
+
+    try {
+        fs::current_path(m_working_directory);
+    } catch(const fs::filesystem_error& e) {
+        std::cerr << cocaine::format("unable to change the working directory to '%s' - %s", path, e.what());
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    // Prepare the command line and the environment
+
+    std::vector<char*> argv = { ::strdup(path.c_str()) }, envp;
+
+    for(auto it = args.begin(); it != args.end(); ++it) {
+        argv.push_back(::strdup(it->first.c_str()));
+        argv.push_back(::strdup(it->second.c_str()));
+    }
+
+    argv.push_back(::strdup("--zygote"));
+    argv.push_back(::strdup(boost::lexical_cast<std::string>(sockets[1]).c_str()));
+    argv.push_back(nullptr);
+
+    for(char** ptr = environ; *ptr != nullptr; ++ptr) {
+        envp.push_back(::strdup(*ptr));
+    }
+
+    boost::format format("%s=%s");
+
+    for(auto it = environment.begin(); it != environment.end(); ++it, format.clear()) {
+        envp.push_back(::strdup((format % it->first % it->second).str().c_str()));
+    }
+
+    envp.push_back(nullptr);
+
+    // Unblock all the signals
+
+    sigset_t signals;
+
+    sigfillset(&signals);
+
+    ::sigprocmask(SIG_UNBLOCK, &signals, nullptr);
+
+    // Spawn the template
+
+    if(::execve(argv[0], argv.data(), envp.data()) != 0) {
+        std::error_code ec(errno, std::system_category());
+        std::cerr << cocaine::format("unable to execute '%s' - [%d] %s", path, ec.value(), ec.message());
+    }
+
+    std::_Exit(EXIT_FAILURE);
+}
+
+void
+zygote_t::stop() {
+    if(m_socket >= 0) {
+        // NOTE: The template is expected to exit once its control socket is closed.
+        ::close(m_socket);
+        m_socket = -1;
+    }
+
+    if(m_pid > 0) {
+        int status = 0;
+
+        ::kill(m_pid, SIGKILL);
+        ::waitpid(m_pid, &status, 0);
+
+        m_pid = 0;
+    }
+
+    if(m_output >= 0) {
+        // Whatever the template has managed to say before dying.
+        drain();
+
+        ::close(m_output);
+        m_output = -1;
+    }
+}
+
+void
+zygote_t::drain() {
+    if(m_output < 0) {
+        return;
+    }
+
+    char buffer[4096];
+    ssize_t length;
+
+    while((length = ::read(m_output, buffer, sizeof(buffer))) > 0) {
+        std::istringstream stream(std::string(buffer, length));
+        std::string line;
+
+        while(std::getline(stream, line)) {
+            if(!line.empty()) {
+                COCAINE_LOG_INFO(m_log, "zygote output: %s", line);
+            }
+        }
+    }
+}
+
+pid_t
+zygote_t::fork(const api::string_map_t& args, int pipe) {
+    std::string request;
+
+    for(auto it = args.begin(); it != args.end(); ++it) {
+        request.append(it->first.c_str(), it->first.size() + 1);
+        request.append(it->second.c_str(), it->second.size() + 1);
+    }
+
+    struct iovec payload = {
+        const_cast<char*>(request.data()),
+        request.size()
+    };
+
+    char control[CMSG_SPACE(sizeof(int))];
+
+    std::memset(control, 0, sizeof(control));
+
+    struct msghdr message;
+
+    std::memset(&message, 0, sizeof(message));
+
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+
+    std::memcpy(CMSG_DATA(header), &pipe, sizeof(int));
+
+    if(::sendmsg(m_socket, &message, MSG_NOSIGNAL) < 0) {
+        throw std::system_error(errno, std::system_category(), "unable to send a zygote request");
+    }
+
+    pid_t pid = 0;
+
+    const ssize_t length = ::recv(m_socket, &pid, sizeof(pid), 0);
+
+    if(length < 0) {
+        throw std::system_error(errno, std::system_category(), "unable to receive a zygote reply");
+    }
+
+    if(length != sizeof(pid)) {
+        throw std::system_error(EPIPE, std::system_category(), "the zygote has closed the socket");
+    }
+
+    if(pid <= 0) {
+        // NOTE: The template itself is fine, it's just unable to fork, so it's not restarted.
+        throw cocaine::error_t("the zygote is unable to fork - %s", std::strerror(-pid));
+    }
+
+    return pid;
+}
@@ -69,5 +69,23 @@ manifest_t::manifest_t(context_t& context, const std::string& name_):
 
     // TODO: Ability to choose app bindpoint.
     local = get("local", false).asBool();
+
+    auto policies = get("cache", Json::Value(Json::objectValue));
+    auto events = policies.getMemberNames();
+
+    for(auto it = events.cbegin(); it != events.cend(); ++it) {
+        const Json::Value& policy = policies[*it];
+
+        cache[*it].ttl = policy.get("ttl", 60.0f).asDouble();
+        cache[*it].limit = policy.get("size", 1048576).asUInt64();
+
+        if(cache[*it].ttl <= 0.0f) {
+            throw cocaine::error_t("cache ttl for event '%s' must be positive", *it);
+        }
+
+        if(cache[*it].limit == 0) {
+            throw cocaine::error_t("cache size for event '%s' must be positive", *it);
+        }
+    }
 }
 
@@ -28,18 +28,25 @@ profile_t::profile_t(context_t& context, const std::string& name_):
     name(name_)
 {
     log_output          = get("log-output", defaults::log_output).asBool();
+    deadline_first      = get("deadline-first", defaults::deadline_first).asBool();
+    sticky_routing      = get("sticky-routing", defaults::sticky_routing).asBool();
+    adaptive_concurrency = get("adaptive-concurrency", defaults::adaptive_concurrency).asBool();
     heartbeat_timeout   = get("heartbeat-timeout", defaults::heartbeat_timeout).asDouble();
     idle_timeout        = get("idle-timeout", defaults::idle_timeout).asDouble();
     startup_timeout     = get("startup-timeout", defaults::startup_timeout).asDouble();
     termination_timeout = get("termination-timeout", defaults::termination_timeout).asDouble();
     concurrency         = get("concurrency", static_cast<Json::UInt>(defaults::concurrency)).asUInt();
     crashlog_limit      = get("crashlog-limit", static_cast<Json::UInt>(defaults::crashlog_limit)).asUInt();
+    decoder_granularity = get("decoder-granularity", static_cast<Json::UInt>(context.config.buffers.granularity)).asUInt();
+    engine_threads      = get("engine-threads", static_cast<Json::UInt>(defaults::engine_threads)).asUInt();
     pool_limit          = get("pool-limit", static_cast<Json::UInt>(defaults::pool_limit)).asUInt();
     queue_limit         = get("queue-limit", static_cast<Json::UInt>(defaults::queue_limit)).asUInt();
 
     unsigned long default_threshold = std::max(1UL, queue_limit / pool_limit * concurrency);
 
     grow_threshold      = get("grow-threshold", static_cast<Json::UInt>(default_threshold)).asUInt();
+    pool_minimum        = get("pool-minimum", static_cast<Json::UInt>(defaults::pool_minimum)).asUInt();
+    spawn_rate          = get("spawn-rate", defaults::spawn_rate).asDouble();
 
     // Isolation
 
@@ -70,8 +77,24 @@ profile_t::profile_t(context_t& context, const std::string& name_):
         throw cocaine::error_t("engine pool limit must be positive");
     }
 
+    if(pool_minimum > pool_limit) {
+        throw cocaine::error_t("engine pool minimum must not exceed the pool limit");
+    }
+
+    if(spawn_rate < 0.0f) {
+        throw cocaine::error_t("engine spawn rate must be non-negative");
+    }
+
     if(concurrency == 0) {
         throw cocaine::error_t("engine concurrency must be positive");
     }
+
+    if(decoder_granularity == 0) {
+        throw cocaine::error_t("decoder granularity must be positive");
+    }
+
+    if(engine_threads == 0) {
+        throw cocaine::error_t("engine thread count must be positive");
+    }
 }
 
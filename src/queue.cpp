@@ -21,13 +21,158 @@
 #include "cocaine/detail/queue.hpp"
 #include "cocaine/detail/session.hpp"
 
+#include <limits>
+
 using namespace cocaine::engine;
 
+session_queue_t::session_queue_t(bool deadline_first):
+    m_deadline_first(deadline_first),
+    m_entries(std::make_shared<detail::recycler_t>(1024)),
+    m_urgent(session_map_t::allocator_type(m_entries)),
+    m_normal(session_map_t::allocator_type(m_entries)),
+    m_deadlines(std::less<key_type>(), session_map_t::allocator_type(m_entries)),
+    m_size(0)
+{ }
+
+session_queue_t::~session_queue_t() {
+    lane_t* lanes[] = { &m_urgent, &m_normal };
+
+    for(size_t i = 0; i < 2; ++i) {
+        node_t* head = lanes[i]->stack.exchange(nullptr);
+
+        while(head) {
+            node_t* node = head;
+            head = node->next;
+
+            delete node;
+        }
+    }
+}
+
+void
+session_queue_t::push(const value_type& session) {
+    lane_t& target = lane(session);
+
+    // NOTE: Account for the session beforehand, so that the consumer never sees the size drop
+    // below zero after popping it.
+    m_size.fetch_add(1, std::memory_order_relaxed);
+
+    node_t* node = new node_t {
+        session,
+        target.stack.load(std::memory_order_relaxed)
+    };
+
+    while(!target.stack.compare_exchange_weak(
+        node->next,
+        node,
+        std::memory_order_release,
+        std::memory_order_relaxed
+    ));
+}
+
+bool
+session_queue_t::pop(value_type& session) {
+    collect(m_urgent);
+
+    // NOTE: Urgent sessions always take precedence, so the normal lane is only collected when
+    // there's nothing urgent to process.
+    if(m_urgent.pending.empty()) {
+        collect(m_normal);
+    }
+
+    lane_t& source = m_urgent.pending.empty() ? m_normal : m_urgent;
+
+    if(source.pending.empty()) {
+        return false;
+    }
+
+    session = std::move(source.pending.begin()->second);
+
+    // Destroy an empty session husk.
+    source.pending.erase(source.pending.begin());
+
+    if(session->event.policy.deadline) {
+        m_deadlines.erase(key_type(session->event.policy.deadline, session->id));
+    }
+
+    m_size.fetch_sub(1, std::memory_order_relaxed);
+
+    return true;
+}
+
 void
-session_queue_t::push(const_reference session) {
-    if(session->event.policy.urgent) {
-        emplace_front(session);
-    } else {
-        emplace_back(session);
+session_queue_t::requeue(const value_type& session) {
+    insert(session);
+
+    m_size.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+session_queue_t::expire(double now, std::vector<value_type>& expired) {
+    collect(m_urgent);
+    collect(m_normal);
+
+    while(!m_deadlines.empty() && m_deadlines.begin()->first.first <= now) {
+        value_type session = std::move(m_deadlines.begin()->second);
+
+        m_deadlines.erase(m_deadlines.begin());
+
+        lane(session).pending.erase(key(session));
+
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+
+        expired.push_back(std::move(session));
+    }
+}
+
+double
+session_queue_t::deadline() const {
+    return m_deadlines.empty() ? 0.0f : m_deadlines.begin()->first.first;
+}
+
+session_queue_t::key_type
+session_queue_t::key(const value_type& session) const {
+    const double deadline = session->event.policy.deadline;
+
+    if(!m_deadline_first) {
+        return key_type(0.0f, session->id);
+    }
+
+    // Sessions without a deadline are scheduled after all the others.
+    return key_type(deadline ? deadline : std::numeric_limits<double>::infinity(), session->id);
+}
+
+session_queue_t::lane_t&
+session_queue_t::lane(const value_type& session) {
+    return session->event.policy.urgent ? m_urgent : m_normal;
+}
+
+void
+session_queue_t::collect(lane_t& source) {
+    if(source.stack.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+
+    node_t* head = source.stack.exchange(nullptr, std::memory_order_acquire);
+
+    while(head) {
+        node_t* node = head;
+        head = node->next;
+
+        insert(node->session);
+
+        delete node;
+    }
+}
+
+void
+session_queue_t::insert(const value_type& session) {
+    lane(session).pending.insert(std::make_pair(key(session), session));
+
+    if(session->event.policy.deadline) {
+        m_deadlines.insert(std::make_pair(
+            key_type(session->event.policy.deadline, session->id),
+            session
+        ));
     }
 }
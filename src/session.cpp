@@ -31,10 +31,9 @@ session_t::session_t(uint64_t id_, const api::event_t& event_, const api::stream
     id(id_),
     event(event_),
     upstream(upstream_),
+    started(0.0f),
     m_state(state::open)
 {
-    m_encoder.reset(new encoder<writable_stream<io::socket<local>>>());
-
     // Cache the invocation command right away.
     send<rpc::invoke>(event.name);
 }
@@ -42,7 +41,7 @@ session_t::session_t(uint64_t id_, const api::event_t& event_, const api::stream
 void
 session_t::attach(const std::shared_ptr<writable_stream<io::socket<local>>>& downstream) {
     // Flush all the cached messages into the downstream.
-    m_encoder->attach(downstream);
+    m_encoder.attach(downstream);
 }
 
 void
@@ -50,7 +49,7 @@ session_t::detach() {
     close();
 
     // Disable the session.
-    m_encoder.reset();
+    m_encoder.detach();
 }
 
 void
@@ -58,13 +57,25 @@ session_t::close() {
     std::lock_guard<std::mutex> lock(m_mutex);
 
     if(m_state == state::open) {
-        m_encoder->write<rpc::choke>(id);
+        m_encoder.write<rpc::choke>(id);
 
         // There shouldn't be any other chunks after that.
         m_state = state::closed;
     }
 }
 
+void
+session_t::cancel(int code, const std::string& reason) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_state == state::open) {
+        m_encoder.write<rpc::error>(id, code, reason);
+        m_encoder.write<rpc::choke>(id);
+
+        m_state = state::closed;
+    }
+}
+
 session_t::downstream_t::downstream_t(const std::shared_ptr<session_t>& parent_):
     parent(parent_)
 { }
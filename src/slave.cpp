@@ -39,6 +39,8 @@
 #include "cocaine/traits/literal.hpp"
 
 #include <array>
+#include <cmath>
+#include <cstring>
 #include <sstream>
 
 #include <boost/lexical_cast.hpp>
@@ -87,6 +89,103 @@ private:
 
 namespace {
 
+// Adaptive concurrency: allowed latency increase over the baseline before backing off, the backoff
+// factor and the baseline drift per second.
+
+const double tolerance = 2.0f;
+const double backoff = 0.9f;
+const double drift = 0.01f;
+
+// Slave output lines longer than this are truncated, so that a single line would never outgrow the
+// output pipe buffer and stop the capture.
+const size_t line_limit = 65536;
+
+}
+
+struct slave_t::pressure_t {
+    void
+    operator()(bool congested) const {
+        // NOTE: This is called from the client's thread, so the slave is notified asynchronously
+        // and only if it's still alive by then.
+        reactor.post(std::bind(&pressure_t::deliver, slave, id, congested));
+    }
+
+    static
+    void
+    deliver(const std::weak_ptr<slave_t>& slave, uint64_t id, bool congested) {
+        if(auto ptr = slave.lock()) {
+            ptr->on_pressure(id, congested);
+        }
+    }
+
+    const std::weak_ptr<slave_t> slave;
+    reactor_t& reactor;
+    const uint64_t id;
+};
+
+struct slave_t::expiration_t {
+    void
+    operator()() const {
+        // NOTE: Sessions are assigned from the engine thread, which can't touch the slave's timers.
+        if(auto ptr = slave.lock()) {
+            ptr->on_expiration(id, deadline);
+        }
+    }
+
+    const std::weak_ptr<slave_t> slave;
+    const uint64_t id;
+    const ev::tstamp deadline;
+};
+
+struct slave_t::spawn_action_t {
+    void
+    operator()() const {
+        std::shared_ptr<api::handle_t> handle;
+        std::string reason;
+
+        try {
+            // NOTE: The process is terminated along with the last handle reference, so it can't
+            // outlive its slave even if this action's result is never delivered.
+            handle.reset(isolate->spawn(executable, args, environment, pipe).release(), terminator());
+        } catch(const std::exception& e) {
+            reason = e.what();
+        }
+
+        // This end of the pipe is already cloned by the isolate, so we can safely close it.
+        ::close(pipe);
+
+        reactor.post(std::bind(&spawn_action_t::deliver, slave, handle, reason));
+    }
+
+    static
+    void
+    deliver(const std::weak_ptr<slave_t>& slave, const std::shared_ptr<api::handle_t>& handle,
+            const std::string& reason)
+    {
+        if(auto ptr = slave.lock()) {
+            ptr->on_spawn(handle, reason);
+        }
+    }
+
+    struct terminator {
+        void
+        operator()(api::handle_t* handle) const {
+            handle->terminate();
+            delete handle;
+        }
+    };
+
+    const api::category_traits<api::isolate_t>::ptr_type isolate;
+    const std::string executable;
+    const api::string_map_t args;
+    const api::string_map_t environment;
+    const int pipe;
+    const std::weak_ptr<slave_t> slave;
+    reactor_t& reactor;
+};
+
+namespace {
+
 struct ignore {
     void
     operator()(const std::error_code& /* ec */) {
@@ -110,6 +209,12 @@ slave_t::slave_t(context_t& context,
     m_id(id),
     m_engine(engine),
     m_state(states::unknown),
+    m_draining(false),
+    m_limit(profile.adaptive_concurrency ? 1 : profile.concurrency),
+    m_window(1.0f),
+    m_baseline(0.0f),
+    m_adapted(0.0f),
+    m_probing(true),
 #if defined(__clang__) || defined(HAVE_GCC47)
     m_birthstamp(std::chrono::steady_clock::now()),
 #else
@@ -117,9 +222,50 @@ slave_t::slave_t(context_t& context,
 #endif
     m_heartbeat_timer(reactor.native()),
     m_idle_timer(reactor.native()),
-    m_output_ring(profile.crashlog_limit)
+    m_output_ring(profile.crashlog_limit),
+    m_output_truncated(false),
+    m_deadline_timer(reactor.native()),
+    m_sessions(profile.concurrency)
 {
-    reactor.update();
+    // NOTE: The watchers are only bound here, as the slave might be created in some other thread
+    // than its reactor's one. They are started once the slave is launched.
+    m_heartbeat_timer.set<slave_t, &slave_t::on_timeout>(this);
+
+    // NOTE: Idle timer will be started on the first heartbeat.
+    m_idle_timer.set<slave_t, &slave_t::on_idle>(this);
+
+    // NOTE: Deadline timer will be started on the first assigned session with a timeout.
+    m_deadline_timer.set<slave_t, &slave_t::on_deadline>(this);
+}
+
+void
+slave_t::launch(const std::string& endpoint, reactor_t& spawner) {
+    m_reactor.post(std::bind(
+        &slave_t::deferred_launch,
+        std::weak_ptr<slave_t>(shared_from_this()),
+        endpoint,
+        std::ref(spawner)
+    ));
+}
+
+void
+slave_t::deferred_launch(const std::weak_ptr<slave_t>& slave, const std::string& endpoint, reactor_t& spawner) {
+    auto ptr = slave.lock();
+
+    if(!ptr) {
+        return;
+    }
+
+    try {
+        ptr->start(endpoint, spawner);
+    } catch(const std::exception& e) {
+        ptr->on_spawn(nullptr, e.what());
+    }
+}
+
+void
+slave_t::start(const std::string& endpoint, reactor_t& spawner) {
+    m_reactor.update();
 
     COCAINE_LOG_DEBUG(
         m_log,
@@ -129,12 +275,8 @@ slave_t::slave_t(context_t& context,
     );
 
     // NOTE: Initialization heartbeat can be different.
-    m_heartbeat_timer.set<slave_t, &slave_t::on_timeout>(this);
     m_heartbeat_timer.start(m_profile.startup_timeout);
 
-    // NOTE: Idle timer will be started on the first heartbeat.
-    m_idle_timer.set<slave_t, &slave_t::on_idle>(this);
-
     auto isolate = m_context.get<api::isolate_t>(
         m_profile.isolate.type,
         m_context,
@@ -147,7 +289,7 @@ slave_t::slave_t(context_t& context,
     api::string_map_t args;
 
     args["--app"] = m_manifest.name;
-    args["--endpoint"] = m_manifest.endpoint;
+    args["--endpoint"] = endpoint;
     args["--locator"] = boost::lexical_cast<std::string>(m_context.config.network.locator);
     args["--uuid"] = m_id;
 
@@ -163,22 +305,24 @@ slave_t::slave_t(context_t& context,
         ::fcntl(*it, F_SETFD, FD_CLOEXEC);
     }
 
-    try {
-        m_handle = isolate->spawn(m_manifest.executable, args, m_manifest.environment, pipes[1]);
-    } catch(...) {
-        std::for_each(pipes.begin(), pipes.end(), ::close);
-        throw;
-    }
-
-    // This end of the pipe is already cloned by the isolate, so we can safely close it.
-    ::close(pipes[1]);
-
-    m_output_pipe.reset(new readable_stream<pipe_t>(reactor, pipes[0]));
+    m_output_pipe.reset(new readable_stream<pipe_t>(m_reactor, pipes[0]));
 
     m_output_pipe->bind(
         std::bind(&slave_t::on_output, this, _1, _2),
         ignore()
     );
+
+    // NOTE: Spawning might block for a considerable amount of time, so it's done in the spawner
+    // thread. The slave will become active on the first heartbeat, as usual.
+    spawner.post(spawn_action_t {
+        isolate,
+        m_manifest.executable,
+        args,
+        m_manifest.environment,
+        pipes[1],
+        shared_from_this(),
+        m_reactor
+    });
 }
 
 slave_t::~slave_t() {
@@ -187,11 +331,12 @@ slave_t::~slave_t() {
 
     m_heartbeat_timer.stop();
     m_idle_timer.stop();
+    m_deadline_timer.stop();
 
     // Closes our end of the socket.
     m_channel.reset();
 
-    m_handle->terminate();
+    // NOTE: This terminates the process, if it has been spawned already.
     m_handle.reset();
 
     COCAINE_LOG_DEBUG(m_log, "slave %s has been terminated", m_id);
@@ -202,7 +347,12 @@ slave_t::bind(const std::shared_ptr<channel<io::socket<local>>>& channel_) {
     BOOST_ASSERT(m_state == states::unknown);
     BOOST_ASSERT(!m_channel);
 
-    m_channel = channel_;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // NOTE: The channel is guarded only to be safely reported from the engine thread.
+        m_channel = channel_;
+    }
 
     m_channel->rd->bind(
         std::bind(&slave_t::on_message, this, _1),
@@ -212,14 +362,22 @@ slave_t::bind(const std::shared_ptr<channel<io::socket<local>>>& channel_) {
     m_channel->wr->bind(
         std::bind(&slave_t::on_failure, this, _1)
     );
+
+    // NOTE: Invocations, chunks and chokes for the slave are small and come in bursts, so they are
+    // coalesced and sent once per loop iteration instead of one syscall per message.
+    m_channel->wr->stream()->cork();
 }
 
 void
 slave_t::assign(const std::shared_ptr<session_t>& session) {
     BOOST_ASSERT(m_state != states::inactive);
 
+    // NOTE: Sessions might be assigned from the engine thread, which can't read the time cached by
+    // this slave's event loop, so the current time is taken directly.
+    const ev::tstamp now = ev::time();
+
     if(session->event.policy.deadline &&
-       session->event.policy.deadline <= m_reactor.native().now())
+       session->event.policy.deadline <= now)
     {
         COCAINE_LOG_DEBUG(m_log, "session %s has expired, dropping", session->id);
 
@@ -233,32 +391,87 @@ slave_t::assign(const std::shared_ptr<session_t>& session) {
 
     std::unique_lock<std::mutex> lock(m_mutex);
 
-    if(m_sessions.size() >= m_profile.concurrency || m_state == states::unknown) {
+    if(m_sessions.size() >= m_limit || m_state == states::unknown) {
         m_queue.push_back(session);
         return;
     }
 
     BOOST_ASSERT(m_state == states::active);
 
-    m_idle_timer.stop();
+    session->started = now;
 
     m_sessions.insert(std::make_pair(session->id, session));
 
     // NOTE: Allows other sessions to be processed while this one is being attached.
     lock.unlock();
 
+    m_engine.reindex(*this);
+
+    session->upstream->watch(pressure_t {
+        shared_from_this(),
+        m_reactor,
+        session->id
+    });
+
+    if(session->event.policy.timeout > 0.0f) {
+        m_reactor.post(expiration_t {
+            shared_from_this(),
+            session->id,
+            now + session->event.policy.timeout
+        });
+    }
+
     COCAINE_LOG_DEBUG(m_log, "slave %s has started processing session %s", m_id, session->id);
 
     session->attach(m_channel->wr->stream());
 }
 
+uint64_t
+slave_t::processed() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_channel ? m_channel->rd->processed() : 0;
+}
+
 void
 slave_t::stop() {
-    BOOST_ASSERT(m_state == states::active);
+    // NOTE: This is called from the engine thread, while the slave's channel and watchers belong
+    // to the shard thread, so the slave is retired there.
+    m_reactor.post(std::bind(&slave_t::deferred_stop, std::weak_ptr<slave_t>(shared_from_this())));
+}
 
-    m_state = states::inactive;
+void
+slave_t::drain() {
+    m_draining = true;
 
-    m_channel->wr->write<rpc::terminate>(0UL, rpc::terminate::normal, "the engine is shutting down");
+    // NOTE: The slave might be idle already, so it has to be pumped once to notice the drain.
+    m_reactor.post(std::bind(&slave_t::deferred_pump, std::weak_ptr<slave_t>(shared_from_this())));
+}
+
+void
+slave_t::deferred_pump(const std::weak_ptr<slave_t>& slave) {
+    if(auto ptr = slave.lock()) {
+        ptr->pump();
+    }
+}
+
+void
+slave_t::deferred_stop(const std::weak_ptr<slave_t>& slave) {
+    if(auto ptr = slave.lock()) {
+        ptr->retire("the engine is shutting down");
+    }
+}
+
+void
+slave_t::on_spawn(const std::shared_ptr<api::handle_t>& handle, const std::string& reason) {
+    if(!handle) {
+        COCAINE_LOG_ERROR(m_log, "unable to spawn slave %s - %s", m_id, reason);
+        terminate(rpc::terminate::code::normal, "unable to spawn the slave");
+        return;
+    }
+
+    // NOTE: The slave might have been terminated already, in which case the process is going to be
+    // killed along with it.
+    m_handle = handle;
 }
 
 void
@@ -285,10 +498,11 @@ slave_t::on_message(const message_t& message) {
     } break;
 
     case event_traits<rpc::chunk>::id: {
-        std::string chunk;
+        literal chunk = { nullptr, 0 };
 
+        // NOTE: The chunk references the channel's read buffer, so it's forwarded without copying.
         message.as<rpc::chunk>(chunk);
-        on_chunk(message.band(), chunk);
+        on_chunk(message.band(), chunk.blob, chunk.size);
     } break;
 
     case event_traits<rpc::error>::id: {
@@ -370,6 +584,8 @@ slave_t::on_ping() {
 
         m_state = states::active;
 
+        m_engine.record_startup(uptime.count());
+
         if(m_profile.idle_timeout) {
             // Start the idle timer, which will kill the slave when it's not used.
             m_idle_timer.start(m_profile.idle_timeout);
@@ -394,7 +610,7 @@ slave_t::on_death(int code, const std::string& reason) {
 }
 
 void
-slave_t::on_chunk(uint64_t session_id, const std::string& chunk) {
+slave_t::on_chunk(uint64_t session_id, const char* chunk, size_t size) {
     BOOST_ASSERT(m_state == states::active);
 
     COCAINE_LOG_DEBUG(
@@ -402,23 +618,27 @@ slave_t::on_chunk(uint64_t session_id, const std::string& chunk) {
         "slave %s received session %d chunk, size: %llu bytes",
         m_id,
         session_id,
-        chunk.size()
+        size
     );
 
-    session_map_t::iterator it;
+    api::stream_t* upstream;
 
     {
         std::lock_guard<std::mutex> guard(m_mutex);
 
-        it = m_sessions.find(session_id);
+        session_map_t::iterator it = m_sessions.find(session_id);
 
         if(it == m_sessions.end()) {
             COCAINE_LOG_WARNING(m_log, "slave %s received orphan session %d chunk", m_id, session_id);
             return;
         }
+
+        // NOTE: Sessions are only erased in this thread, so the upstream can be used outside the
+        // lock, while the session table might be modified concurrently.
+        upstream = it->second->upstream.get();
     }
 
-    it->second->upstream->write(chunk.data(), chunk.size());
+    upstream->write(chunk, size);
 }
 
 void
@@ -434,20 +654,24 @@ slave_t::on_error(uint64_t session_id, int code, const std::string& reason) {
         reason
     );
 
-    session_map_t::iterator it;
+    api::stream_t* upstream;
 
     {
         std::lock_guard<std::mutex> guard(m_mutex);
 
-        it = m_sessions.find(session_id);
+        session_map_t::iterator it = m_sessions.find(session_id);
 
         if(it == m_sessions.end()) {
             COCAINE_LOG_WARNING(m_log, "slave %s received orphan session %d error", m_id, session_id);
             return;
         }
+
+        // NOTE: Sessions are only erased in this thread, so the upstream can be used outside the
+        // lock, while the session table might be modified concurrently.
+        upstream = it->second->upstream.get();
     }
 
-    it->second->upstream->error(code, reason);
+    upstream->error(code, reason);
 }
 
 void
@@ -478,15 +702,159 @@ slave_t::on_choke(uint64_t session_id) {
         m_sessions.erase(it);
     }
 
+    session->upstream->watch(nullptr);
+
+    // The session is complete, so it can't hold the slave back anymore.
+    on_pressure(session_id, false);
+
     session->upstream->close();
     session->detach();
 
+    // NOTE: The start time is taken directly, while the loop time might lag a bit behind it.
+    const double latency = std::max(m_reactor.native().now() - session->started, 0.0);
+
+    m_engine.record_service(latency);
+
+    if(m_profile.adaptive_concurrency) {
+        adapt(latency);
+    }
+
     // Destroy the session before calling the potentially heavy queue pumps.
     session.reset();
 
     pump();
 }
 
+void
+slave_t::on_pressure(uint64_t session_id, bool congested) {
+    if(congested) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if(m_sessions.find(session_id) == m_sessions.end()) {
+                return;
+            }
+        }
+
+        if(m_congested.insert(session_id).second && m_congested.size() == 1) {
+            COCAINE_LOG_DEBUG(
+                m_log,
+                "slave %s is throttled, session %d client can't keep up",
+                m_id,
+                session_id
+            );
+
+            // Stop reading from the slave, so that the backpressure propagates to it.
+            m_channel->rd->stream()->pause();
+        }
+    } else if(m_congested.erase(session_id) && m_congested.empty()) {
+        COCAINE_LOG_DEBUG(m_log, "slave %s is no longer throttled", m_id);
+
+        m_channel->rd->stream()->resume();
+    }
+}
+
+void
+slave_t::on_expiration(uint64_t session_id, ev::tstamp deadline) {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(m_sessions.find(session_id) == m_sessions.end()) {
+            // The session has been completed already.
+            return;
+        }
+    }
+
+    m_deadlines.insert(std::make_pair(deadline, session_id));
+
+    if(m_deadlines.begin()->second == session_id) {
+        m_deadline_timer.stop();
+        m_deadline_timer.start(std::max(deadline - m_reactor.native().now(), 0.0));
+    }
+}
+
+void
+slave_t::on_deadline(ev::timer&, int) {
+    const ev::tstamp now = m_reactor.native().now();
+
+    while(!m_deadlines.empty() && m_deadlines.begin()->first <= now) {
+        const uint64_t session_id = m_deadlines.begin()->second;
+
+        m_deadlines.erase(m_deadlines.begin());
+
+        session_map_t::mapped_type session;
+
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            session_map_t::iterator it = m_sessions.find(session_id);
+
+            if(it == m_sessions.end()) {
+                continue;
+            }
+
+            session = std::move(it->second);
+
+            m_sessions.erase(it);
+        }
+
+        COCAINE_LOG_DEBUG(m_log, "slave %s has timed out session %d", m_id, session_id);
+
+        session->upstream->watch(nullptr);
+
+        // The session is abandoned, so it can't hold the slave back anymore.
+        on_pressure(session_id, false);
+
+        session->upstream->error(timeout_error, "the session has timed out");
+        session->upstream->close();
+
+        // Let the slave know that it can stop processing the session.
+        session->cancel(timeout_error, "the session has timed out");
+        session->detach();
+    }
+
+    if(!m_deadlines.empty()) {
+        m_deadline_timer.start(std::max(m_deadlines.begin()->first - now, 0.0));
+    }
+
+    pump();
+}
+
+void
+slave_t::adapt(double latency) {
+    const ev::tstamp now = m_reactor.native().now();
+
+    // NOTE: The latency without queueing in the slave is tracked as the minimal observed latency,
+    // which is allowed to slowly drift upwards, so that it would follow the app's own slowdowns.
+    // The drift depends on the time passed since the last completion rather than on the number of
+    // completions, so that it doesn't run away under a high load and doesn't stall under a low one.
+    if(m_baseline) {
+        m_baseline = std::min(latency, m_baseline * std::pow(1.0f + drift, std::max(now - m_adapted, 0.0)));
+    } else {
+        m_baseline = latency;
+    }
+
+    m_adapted = now;
+
+    if(latency <= m_baseline * tolerance) {
+        // Grow fast until the first congestion, and then by a session per window of completions.
+        m_window += m_probing ? 1.0f : 1.0f / m_window;
+    } else {
+        m_window *= backoff;
+        m_probing = false;
+    }
+
+    m_window = std::max(1.0, std::min<double>(m_window, m_profile.concurrency));
+
+    const size_t limit = m_window;
+
+    if(limit != m_limit) {
+        COCAINE_LOG_DEBUG(m_log, "slave %s concurrency limit is now %d", m_id, limit);
+
+        m_limit = limit;
+    }
+}
+
 void
 slave_t::on_timeout(ev::timer&, int) {
     switch(m_state) {
@@ -510,17 +878,45 @@ slave_t::on_timeout(ev::timer&, int) {
 void
 slave_t::on_idle(ev::timer&, int) {
     BOOST_ASSERT(m_state == states::active);
-    BOOST_ASSERT(m_sessions.empty() && m_queue.empty());
 
-    COCAINE_LOG_DEBUG(m_log, "slave %s is idle, deactivating", m_id);
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
 
-    m_state = states::inactive;
+        // NOTE: Sessions might be assigned from the engine thread, which can't touch this slave's
+        // timers, so the idle timer is not stopped on assignment, but rather checked here.
+        if(!m_sessions.empty() || !m_queue.empty()) {
+            return;
+        }
+    }
+
+    if(!m_draining && !m_engine.surplus()) {
+        // Keep the slave warm, as the pool would shrink below the configured minimum otherwise.
+        m_idle_timer.start(m_profile.idle_timeout);
+        return;
+    }
 
-    m_channel->wr->write<rpc::terminate>(0UL, rpc::terminate::normal, "slave is idle");
+    COCAINE_LOG_DEBUG(m_log, "slave %s is idle, deactivating", m_id);
+
+    retire("slave is idle");
 }
 
 size_t
 slave_t::on_output(const char* data, size_t size) {
+    if(m_output_truncated) {
+        // Skip the rest of the truncated line.
+        const char* end = static_cast<const char*>(std::memchr(data, '\n', size));
+
+        if(end == nullptr) {
+            return size;
+        }
+
+        m_output_truncated = false;
+
+        const size_t skipped = end - data + 1;
+
+        return skipped + on_output(data + skipped, size - skipped);
+    }
+
     std::string input(data, size),
                 line;
 
@@ -528,30 +924,49 @@ slave_t::on_output(const char* data, size_t size) {
 
     size_t leftovers = 0;
 
-    while(stream) {
-        if(std::getline(stream, line)) {
-            m_output_ring.push_back(line);
-
-            if(m_profile.log_output) {
-                COCAINE_LOG_DEBUG(m_log, "slave %s output: %s", m_id, line);
-            }
-        } else {
+    while(std::getline(stream, line)) {
+        if(stream.eof()) {
+            // NOTE: A line which ends at the end of the input is incomplete, so it's left in the
+            // pipe buffer until the rest of it arrives.
             leftovers = line.size();
+            break;
+        }
+
+        m_output_ring.push_back(line);
+
+        if(m_profile.log_output) {
+            COCAINE_LOG_DEBUG(m_log, "slave %s output: %s", m_id, line);
         }
     }
 
+    // NOTE: The pipe buffer can't grow beyond the buffer size limit, so an incomplete line which is
+    // too long is captured as is and the rest of it is dropped.
+    if(leftovers && leftovers >= std::min<size_t>(line_limit, buffer_pool().policy().size_limit / 2)) {
+        COCAINE_LOG_WARNING(m_log, "slave %s output line exceeds %d bytes, truncating", m_id, leftovers);
+
+        m_output_ring.push_back(line);
+
+        if(m_profile.log_output) {
+            COCAINE_LOG_DEBUG(m_log, "slave %s output: %s", m_id, line);
+        }
+
+        m_output_truncated = true;
+
+        return size;
+    }
+
     return size - leftovers;
 }
 
 void
 slave_t::pump() {
-    session_queue_t::value_type session;
+    pending_queue_t::value_type session;
 
     while(!m_queue.empty()) {
         {
             std::lock_guard<std::mutex> guard(m_mutex);
 
-            if(m_queue.empty() || m_sessions.size() >= m_profile.concurrency) {
+            if(m_queue.empty() || m_sessions.size() >= m_limit) {
                 break;
             }
 
@@ -565,13 +980,50 @@ slave_t::pump() {
         assign(session);
     }
 
+    if(m_draining && m_state == states::active) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if(!m_sessions.empty() || !m_queue.empty()) {
+                return;
+            }
+        }
+
+        COCAINE_LOG_DEBUG(m_log, "slave %s has been drained, deactivating", m_id);
+
+        retire("slave is no longer needed");
+
+        return;
+    }
+
     if(m_sessions.empty() && m_profile.idle_timeout) {
+        // Restart the idle timer, as it might still be running since the previous idle period.
+        m_idle_timer.stop();
         m_idle_timer.start(m_profile.idle_timeout);
     }
 
+    // Let the engine know that this slave might accept more sessions now.
+    m_engine.reindex(*this);
     m_engine.wake();
 }
 
+void
+slave_t::retire(const std::string& reason) {
+    states expected = states::active;
+
+    // NOTE: The slave might have been deactivated or terminated in the meantime, in which case it
+    // must not be retired twice.
+    if(!m_state.compare_exchange_strong(expected, states::inactive)) {
+        return;
+    }
+
+    // NOTE: The slave won't be sent anything else, so there's nothing to coalesce anymore. Flush
+    // whatever is queued right away, as the reactor might be stopped before the next iteration.
+    m_channel->wr->stream()->uncork();
+
+    m_channel->wr->write<rpc::terminate>(0UL, rpc::terminate::normal, reason);
+}
+
 void
 slave_t::dump() {
     if(m_output_ring.empty()) {
@@ -602,6 +1054,7 @@ struct detach_with {
     template<class T>
     void
     operator()(const T& session) const {
+        session.second->upstream->watch(nullptr);
         session.second->upstream->error(code, message);
         session.second->detach();
     }
@@ -629,5 +1082,10 @@ slave_t::terminate(int code, const std::string& reason) {
         m_sessions.clear();
     }
 
+    m_congested.clear();
+
+    m_deadlines.clear();
+    m_deadline_timer.stop();
+
     m_reactor.post(std::bind(&engine_t::erase, std::ref(m_engine), m_id, code, reason));
 }
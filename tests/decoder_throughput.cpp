@@ -0,0 +1,200 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measures how fast a large frame arriving in 64 KiB reads is decoded by the incremental decoder,
+// against a reference which re-parses the whole buffered frame on every read, which is how the
+// decoder used to work. Two frames are used: a single large chunk and an array of small strings.
+
+#include "cocaine/rpc/decoder.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include <ev++.h>
+
+using namespace cocaine::io;
+
+namespace {
+
+const size_t read_size = 64 * 1024;
+
+// Stands in for readable_stream: it only remembers the callback the decoder binds to it.
+
+struct feed_t {
+    template<class Handler, class ErrorHandler>
+    void
+    bind(Handler handler, ErrorHandler) {
+        callback = handler;
+    }
+
+    void
+    unbind() {
+        callback = nullptr;
+    }
+
+    std::function<
+        size_t(const char*, size_t)
+    > callback;
+};
+
+struct on_message_t {
+    void
+    operator()(const message_t&) {
+        ++*count;
+    }
+
+    size_t* count;
+};
+
+struct on_error_t {
+    void
+    operator()(const std::error_code& ec) {
+        std::fprintf(stderr, "decoding error: %s\n", ec.message().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+};
+
+void
+pack_chunk(msgpack::sbuffer& buffer, size_t size) {
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+    const std::string chunk(size, 'x');
+
+    packer.pack_array(3);
+    packer.pack_uint32(1);
+    packer.pack_uint64(1);
+    packer.pack_array(1);
+    packer.pack_raw(chunk.size());
+    packer.pack_raw_body(chunk.data(), chunk.size());
+}
+
+void
+pack_strings(msgpack::sbuffer& buffer, size_t size) {
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+    const std::string item(15, 'x');
+    const size_t items = size / (item.size() + 1);
+
+    packer.pack_array(3);
+    packer.pack_uint32(1);
+    packer.pack_uint64(1);
+    packer.pack_array(items);
+
+    for(size_t i = 0; i < items; ++i) {
+        packer.pack_raw(item.size());
+        packer.pack_raw_body(item.data(), item.size());
+    }
+}
+
+// Feeds the frame to the decoder one read at a time, keeping the unconsumed tail like the stream.
+
+size_t
+decode(const msgpack::sbuffer& buffer) {
+    auto feed = std::make_shared<feed_t>();
+
+    size_t count = 0;
+
+    decoder<feed_t> decoder;
+
+    decoder.attach(feed);
+    decoder.bind(on_message_t { &count }, on_error_t());
+
+    size_t rx = 0,
+           rd = 0;
+
+    while(rd != buffer.size()) {
+        rd = std::min(rd + read_size, buffer.size());
+        rx += feed->callback(buffer.data() + rx, rd - rx);
+    }
+
+    return count;
+}
+
+size_t
+reparse(const msgpack::sbuffer& buffer) {
+    size_t count = 0,
+           rd = 0;
+
+    while(rd != buffer.size()) {
+        rd = std::min(rd + read_size, buffer.size());
+
+        msgpack::zone zone;
+        msgpack::object object;
+        size_t offset = 0;
+
+        switch(msgpack::unpack(buffer.data(), rd, &offset, &zone, &object)) {
+        case msgpack::UNPACK_SUCCESS:
+            ++count;
+            break;
+
+        case msgpack::UNPACK_CONTINUE:
+            break;
+
+        default:
+            on_error_t()(make_error_code(rpc_errc::parse_error));
+        }
+    }
+
+    return count;
+}
+
+template<class Decoder>
+double
+measure(Decoder decoder, const msgpack::sbuffer& buffer, size_t rounds) {
+    const double started = ev::time();
+
+    for(size_t i = 0; i < rounds; ++i) {
+        if(decoder(buffer) != 1) {
+            std::fprintf(stderr, "the frame has not been decoded\n");
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    return rounds * buffer.size() / (ev::time() - started) / (1024 * 1024);
+}
+
+}
+
+int
+main(int argc, char* argv[]) {
+    const size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10 * 1024 * 1024;
+    const size_t rounds = 4;
+
+    msgpack::sbuffer chunk,
+                     strings;
+
+    pack_chunk(chunk, size);
+    pack_strings(strings, size);
+
+    std::printf("%-10s %12s %16s %16s\n", "frame", "size, bytes", "decoder, MiB/s", "reparse, MiB/s");
+
+    std::printf("%-10s %12zu %16.1f %16.1f\n", "chunk", chunk.size(),
+        measure(&decode, chunk, rounds),
+        measure(&reparse, chunk, rounds));
+
+    std::printf("%-10s %12zu %16.1f %16.1f\n", "strings", strings.size(),
+        measure(&decode, strings, rounds),
+        measure(&reparse, strings, rounds));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Counts heap allocations on the message hot path once it's warmed up: decoding chunks through the
+// decoder, unpacking their payloads into literals, and creating upstream-sized objects through the
+// recycler. Every one of these is expected to be allocation-free, otherwise the test fails.
+
+#include "cocaine/messages.hpp"
+
+#include "cocaine/detail/recycler.hpp"
+
+#include "cocaine/rpc/decoder.hpp"
+
+#include "cocaine/traits/literal.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+using namespace cocaine;
+using namespace cocaine::io;
+
+namespace {
+
+size_t allocations = 0;
+
+}
+
+void*
+operator new(size_t size) {
+    ++allocations;
+
+    if(void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+// Small enough for frames to straddle the reads every now and then.
+const size_t read_size = 4096;
+
+struct feed_t {
+    template<class Handler, class ErrorHandler>
+    void
+    bind(Handler handler, ErrorHandler) {
+        callback = handler;
+    }
+
+    void
+    unbind() {
+        callback = nullptr;
+    }
+
+    std::function<
+        size_t(const char*, size_t)
+    > callback;
+};
+
+struct on_chunk_t {
+    void
+    operator()(const message_t& message) {
+        literal chunk;
+
+        message.as<rpc::chunk>(chunk);
+
+        ++*count;
+        *bytes += chunk.size;
+    }
+
+    size_t* count;
+    size_t* bytes;
+};
+
+struct on_error_t {
+    void
+    operator()(const std::error_code& ec) {
+        std::fprintf(stderr, "decoding error: %s\n", ec.message().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+};
+
+// Stands in for an upstream: a couple of pointers and a session id.
+
+struct payload_t {
+    std::shared_ptr<void> owner;
+    uint64_t id;
+};
+
+void
+feed(feed_t& stream, const msgpack::sbuffer& buffer) {
+    size_t rx = 0,
+           rd = 0;
+
+    while(rx != buffer.size()) {
+        rd = std::min(rd + read_size, buffer.size());
+        rx += stream.callback(buffer.data() + rx, rd - rx);
+    }
+}
+
+size_t
+recycle(const std::shared_ptr<cocaine::detail::recycler_t>& recycler, size_t count) {
+    cocaine::detail::recycling_allocator<payload_t> allocator(recycler);
+
+    uint64_t sum = 0;
+
+    for(size_t i = 0; i < count; ++i) {
+        auto payload = std::allocate_shared<payload_t>(allocator);
+
+        payload->id = i;
+        sum += payload->id;
+    }
+
+    return sum;
+}
+
+}
+
+int
+main(int argc, char* argv[]) {
+    const size_t messages = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+    const std::string payload(100, 'x');
+
+    for(size_t i = 0; i < messages; ++i) {
+        packer.pack_array(3);
+        packer.pack_uint32(io::event_traits<rpc::chunk>::id);
+        packer.pack_uint64(i + 1);
+        packer.pack_array(1);
+        packer.pack_raw(payload.size());
+        packer.pack_raw_body(payload.data(), payload.size());
+    }
+
+    auto stream = std::make_shared<feed_t>();
+
+    size_t count = 0,
+           bytes = 0;
+
+    decoder<feed_t> decoder;
+
+    decoder.attach(stream);
+    decoder.bind(on_chunk_t { &count, &bytes }, on_error_t());
+
+    auto recycler = std::make_shared<cocaine::detail::recycler_t>(16);
+
+    // Warm up the zone and the free list, so that only the steady state is measured.
+    feed(*stream, buffer);
+    recycle(recycler, 1);
+
+    allocations = 0;
+
+    feed(*stream, buffer);
+
+    const size_t decoding = allocations;
+
+    allocations = 0;
+
+    recycle(recycler, messages);
+
+    const size_t recycling = allocations;
+
+    std::printf("%-10s %12s %16s\n", "path", "operations", "allocations/op");
+    std::printf("%-10s %12zu %16.3f\n", "decoding", messages, double(decoding) / messages);
+    std::printf("%-10s %12zu %16.3f\n", "recycling", messages, double(recycling) / messages);
+
+    if(count != messages * 2 || bytes != count * payload.size()) {
+        std::fprintf(stderr, "decoded %zu messages instead of %zu\n", count, messages * 2);
+        return EXIT_FAILURE;
+    }
+
+    return decoding == 0 && recycling == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,158 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measures the reactor_t::post() throughput with 1 to 16 producer threads against a reference
+// mutex-guarded job deque, which is how the reactor job queue used to be implemented.
+
+#include "cocaine/asio/reactor.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace cocaine::io;
+
+namespace {
+
+// Reference queue: every post takes the mutex, and the consumer re-locks it for every job.
+
+struct locked_queue_t {
+    locked_queue_t():
+        m_stopped(false)
+    { }
+
+    void
+    post(std::function<void()> job) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_jobs.push_back(std::move(job));
+        m_condition.notify_one();
+    }
+
+    void
+    run() {
+        while(true) {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                while(m_jobs.empty() && !m_stopped) {
+                    m_condition.wait(lock);
+                }
+
+                if(m_jobs.empty()) {
+                    return;
+                }
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            job();
+        }
+    }
+
+    void
+    stop() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_stopped = true;
+        m_condition.notify_one();
+    }
+
+private:
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    bool m_stopped;
+};
+
+// Counts the executed jobs in the consumer thread and stops it after the last one.
+
+template<class Queue>
+struct counter_t {
+    void
+    operator()() {
+        if(++*count == total) {
+            queue->stop();
+        }
+    }
+
+    Queue* queue;
+    size_t* count;
+    size_t total;
+};
+
+template<class Queue>
+void
+produce(Queue* queue, size_t* count, size_t total, size_t jobs) {
+    for(size_t i = 0; i < jobs; ++i) {
+        queue->post(counter_t<Queue> { queue, count, total });
+    }
+}
+
+template<class Queue>
+double
+measure(Queue& queue, size_t producers, size_t jobs) {
+    size_t count = 0;
+
+    std::vector<std::thread> threads;
+
+    const double started = ev::time();
+
+    for(size_t i = 0; i < producers; ++i) {
+        threads.emplace_back(&produce<Queue>, &queue, &count, producers * jobs, jobs);
+    }
+
+    queue.run();
+
+    for(auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    return producers * jobs / (ev::time() - started);
+}
+
+}
+
+int
+main(int argc, char* argv[]) {
+    const size_t jobs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+
+    std::printf("%-10s %16s %16s\n", "producers", "reactor, posts/s", "locked, posts/s");
+
+    for(size_t producers = 1; producers <= 16; producers *= 2) {
+        reactor_t reactor;
+        locked_queue_t reference;
+
+        const double lock_free = measure(reactor, producers, jobs);
+        const double locked = measure(reference, producers, jobs);
+
+        std::printf("%-10zu %16.0f %16.0f\n", producers, lock_free, locked);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/*
+    Copyright (c) 2011-2013 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2013 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Reports heap allocations per request over the engine's session lifecycle, i.e. create, queue,
+// pop, write a chunk and close, with sessions and downstreams created the way the engine does it,
+// through the recyclers, against plain std::make_shared().
+
+#include "cocaine/detail/queue.hpp"
+#include "cocaine/detail/recycler.hpp"
+#include "cocaine/detail/session.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+using namespace cocaine;
+using namespace cocaine::engine;
+
+namespace {
+
+size_t allocations = 0;
+
+}
+
+void*
+operator new(size_t size) {
+    ++allocations;
+
+    if(void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+struct recycled_t {
+    recycled_t(size_t limit):
+        sessions(std::make_shared<cocaine::detail::recycler_t>(limit)),
+        downstreams(std::make_shared<cocaine::detail::recycler_t>(limit))
+    { }
+
+    std::shared_ptr<session_t>
+    create(uint64_t id, const api::event_t& event, const api::stream_ptr_t& upstream) {
+        return std::allocate_shared<session_t>(
+            cocaine::detail::recycling_allocator<session_t>(sessions),
+            id,
+            event,
+            upstream
+        );
+    }
+
+    std::shared_ptr<api::stream_t>
+    downstream(const std::shared_ptr<session_t>& session) {
+        return std::allocate_shared<session_t::downstream_t>(
+            cocaine::detail::recycling_allocator<session_t::downstream_t>(downstreams),
+            session
+        );
+    }
+
+    const std::shared_ptr<cocaine::detail::recycler_t> sessions;
+    const std::shared_ptr<cocaine::detail::recycler_t> downstreams;
+};
+
+struct heap_t {
+    heap_t(size_t /* limit */) { }
+
+    std::shared_ptr<session_t>
+    create(uint64_t id, const api::event_t& event, const api::stream_ptr_t& upstream) {
+        return std::make_shared<session_t>(id, event, upstream);
+    }
+
+    std::shared_ptr<api::stream_t>
+    downstream(const std::shared_ptr<session_t>& session) {
+        return std::make_shared<session_t::downstream_t>(session);
+    }
+};
+
+// Runs the requests in batches of the given size, so that the queue holds several sessions at once
+// like it does under load.
+
+template<class Factory>
+void
+run(Factory& factory, session_queue_t& queue, size_t requests, size_t batch) {
+    const api::event_t event("ping");
+    const api::stream_ptr_t upstream = std::make_shared<api::null_stream_t>();
+
+    for(size_t i = 0; i < requests; i += batch) {
+        for(size_t j = 0; j < batch; ++j) {
+            queue.push(factory.create(i + j + 1, event, upstream));
+        }
+
+        std::shared_ptr<session_t> session;
+
+        while(queue.pop(session)) {
+            std::shared_ptr<api::stream_t> downstream = factory.downstream(session);
+
+            downstream->write("pong", 4);
+            downstream->close();
+        }
+    }
+}
+
+template<class Factory>
+void
+measure(const char* name, size_t requests, size_t batch) {
+    Factory factory(batch);
+    session_queue_t queue(false);
+
+    // Warm up the free lists, so that only the steady state is measured.
+    run(factory, queue, batch, batch);
+
+    allocations = 0;
+
+    const double started = ev::time();
+
+    run(factory, queue, requests, batch);
+
+    const double elapsed = ev::time() - started;
+
+    std::printf("%-10s %12zu %20.3f %16.0f\n", name, requests, double(allocations) / requests,
+        requests / elapsed);
+}
+
+}
+
+int
+main(int argc, char* argv[]) {
+    const size_t requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t batch = 64;
+
+    std::printf("%-10s %12s %20s %16s\n", "sessions", "requests", "allocations/request", "requests/s");
+
+    measure<recycled_t>("recycled", requests, batch);
+    measure<heap_t>("heap", requests, batch);
+
+    return EXIT_SUCCESS;
+}